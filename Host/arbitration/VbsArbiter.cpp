@@ -0,0 +1,80 @@
+/*
+    VbsArbiter.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsArbiter.h"
+#include <algorithm>
+#include <time.h>
+
+VbsArbiter::VbsArbiter(const uint64_t window) :
+    _window(window)
+{
+}
+
+VbsPress* VbsArbiter::find(const std::string& device)
+{
+    for (VbsPress& press : _presses)
+    {
+        if (press.Device == device) return &press;
+    }
+    return NULL;
+}
+
+void VbsArbiter::startRound(const uint64_t arrival)
+{
+    if (_deadline == 0) _deadline = arrival + _window;
+}
+
+void VbsArbiter::AddPress(const std::string& device, const uint64_t arrival)
+{
+    if (find(device)) return;
+    
+    startRound(arrival);
+    _presses.push_back({ device, arrival, false });
+}
+
+void VbsArbiter::AddPressTime(const std::string& device, const uint32_t time, const uint64_t arrival)
+{
+    // Only the first press of a button counts in a round
+    VbsPress* press = find(device);
+    if (press && press->Timestamped) return;
+    
+    startRound(arrival);
+    if (!press)
+    {
+        _presses.push_back({ device, 0, true });
+        press = &_presses.back();
+    }
+    press->Time = Unwrap(time, arrival);
+    press->Timestamped = true;
+}
+
+bool VbsArbiter::Poll(const uint64_t now, std::vector<VbsPress>& ranking)
+{
+    if (_deadline == 0 || now < _deadline) return false;
+    
+    ranking = _presses;
+    std::stable_sort(ranking.begin(), ranking.end(), [](const VbsPress& a, const VbsPress& b) { return a.Time < b.Time; });
+    _presses.clear();
+    _deadline = 0;
+    return true;
+}
+
+uint64_t VbsArbiter::GetDeadline() const
+{
+    return _deadline;
+}
+
+uint64_t VbsArbiter::Unwrap(const uint32_t time, const uint64_t reference)
+{
+    return reference + (int64_t)(int32_t)(time - (uint32_t)reference);
+}
+
+uint64_t VbsArbiter::HostClock()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
@@ -0,0 +1,63 @@
+/*
+    VbsArbiter.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Decides which of several buttons was pressed first. The buttons timestamp their presses on the
+    host clock (VENDOR_PRESS_TIME, see "Which button was first" in the README), so the order does
+    not depend on when the reports arrive. A round starts with the first press and ends after a
+    window long enough for the reports of the other buttons to arrive. Presses without a timestamp
+    (the button is not synchronized, or lost the sync) take part with their arrival time.
+    
+    All times are on the host clock in microseconds, the same clock the host writes into the clock
+    sync feature report of the buttons (HostClock()).
+*/
+
+#ifndef VBS_ARBITER_h
+#define VBS_ARBITER_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct VbsPress
+{
+    std::string Device;
+    uint64_t Time;      // press time, or arrival time without a timestamp
+    bool Timestamped;
+};
+
+class VbsArbiter
+{
+private:
+    uint64_t _window;
+    uint64_t _deadline = 0; // (end of the current round, 0 = no round)
+    std::vector<VbsPress> _presses;
+    
+    VbsPress* find(const std::string& device);
+    void startRound(const uint64_t arrival);
+    
+public:
+    // Window in microseconds
+    VbsArbiter(const uint64_t window = 20000);
+    
+    // A press reported by a key or button report (its timestamp replaces the arrival time if one follows in the round)
+    void AddPress(const std::string& device, const uint64_t arrival);
+    
+    // Press timestamp of a button (low 32 bits of the host clock, from VENDOR_PRESS_TIME)
+    void AddPressTime(const std::string& device, const uint32_t time, const uint64_t arrival);
+    
+    // True once the round is over, with the presses of the round, earliest first
+    bool Poll(const uint64_t now, std::vector<VbsPress>& ranking);
+    
+    // End of the current round, 0 if there is none
+    uint64_t GetDeadline() const;
+    
+    // The full time of a 32-bit timestamp that is within 35 minutes of the reference
+    static uint64_t Unwrap(const uint32_t time, const uint64_t reference);
+    
+    // Host clock of the synchronization: CLOCK_MONOTONIC in microseconds
+    static uint64_t HostClock();
+};
+
+#endif
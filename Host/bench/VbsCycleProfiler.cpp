@@ -0,0 +1,123 @@
+/*
+    VbsCycleProfiler.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsCycleProfiler.h"
+#include <sstream>
+
+#define MAX_DEPTH 64
+
+// Name without the parameter list, as patterns are written
+static std::string BaseName(const std::string& name)
+{
+    const size_t paren = name.find('(');
+    return paren == std::string::npos ? name : name.substr(0, paren);
+}
+
+static bool Matches(const std::string& name, const std::vector<std::string>& patterns)
+{
+    const std::string base = BaseName(name);
+    for (const auto& pattern : patterns)
+    {
+        if (!pattern.empty() && pattern.back() == '*')
+        {
+            if (base.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0) return true;
+        }
+        else if (base == pattern)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int VbsCycleProfiler::AddFunctions(std::istream& symbols, const std::vector<std::string>& patterns)
+{
+    int added = 0;
+    std::string line;
+    while (std::getline(symbols, line))
+    {
+        // "00000abc T VbsBigRedButton::readButton()"
+        std::istringstream stream(line);
+        uint32_t address;
+        char type;
+        std::string name;
+        if (!(stream >> std::hex >> address >> type)) continue;
+        std::getline(stream >> std::ws, name);
+        
+        // Code only (data symbols are in the 0x800000 range with other types)
+        if (type != 'T' && type != 't' && type != 'W' && type != 'w') continue;
+        if (name.empty() || !Matches(name, patterns)) continue;
+        
+        const uint32_t word = address / 2;
+        if (word < _entries.size() && _entries[word] >= 0) continue; // aliases of one address
+        if (word >= _entries.size()) _entries.resize(word + 1, -1);
+        _entries[word] = _functions.size();
+        
+        Function function = {};
+        function.Name = name;
+        function.Address = address;
+        function.Interrupt = name.compare(0, 9, "__vector_") == 0;
+        _functions.push_back(function);
+        added++;
+    }
+    return added;
+}
+
+void VbsCycleProfiler::Step(const uint32_t pc, const uint16_t sp, const uint8_t* data, const uint64_t cycle)
+{
+    // A function is done once the stack is back above its return address (ret, reti, or unwinding past it).
+    // Until then the stack pointer can only be lower, the function and whatever it calls push below it.
+    while (!_stack.empty() && sp >= _stack.back().Sp + 2)
+    {
+        const Frame& frame = _stack.back();
+        Function& function = _functions[frame.Function];
+        const uint64_t cycles = cycle - frame.Start;
+        function.Calls++;
+        function.Cycles += cycles;
+        if (cycles > function.MaxCycles) function.MaxCycles = cycles;
+        _stack.pop_back();
+    }
+    
+    const uint32_t word = pc / 2;
+    if (word < _entries.size() && _entries[word] >= 0 && _stack.size() < MAX_DEPTH)
+    {
+        // A call leaves the address of the next instruction on the stack (word address, high byte on top),
+        // a jump to the entry (tail call) does not. Interrupts push the address they interrupted.
+        const int index = _entries[word];
+        const uint32_t returnPc = ((uint32_t)data[sp + 1] << 8 | data[sp + 2]) * 2;
+        if (_functions[index].Interrupt || (returnPc > _lastPc && returnPc <= _lastPc + 4))
+        {
+            _stack.push_back({ index, sp, cycle });
+        }
+    }
+    _lastPc = pc;
+}
+
+void VbsCycleProfiler::ClearCounters()
+{
+    for (auto& function : _functions)
+    {
+        function.Calls = 0;
+        function.Cycles = 0;
+        function.MaxCycles = 0;
+    }
+}
+
+void VbsCycleProfiler::Reset()
+{
+    ClearCounters();
+    _stack.clear();
+    _lastPc = 0;
+}
+
+const VbsCycleProfiler::Function* VbsCycleProfiler::Find(const std::string& name) const
+{
+    for (const auto& function : _functions)
+    {
+        if (BaseName(function.Name) == name) return &function;
+    }
+    return nullptr;
+}
@@ -0,0 +1,65 @@
+/*
+    VbsCycleProfiler.h
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    Cycles spent in the functions of an AVR firmware, from the program counter and the stack pointer
+    after every instruction of a simulator. A function starts when a call (or an interrupt) arrives
+    at its entry, and ends when the stack is unwound past its return address, so the numbers are
+    inclusive: callees and interrupts that hit in the meantime are counted too. Functions the
+    compiler inlined have no entry of their own and count into their callers.
+*/
+
+#ifndef VBS_CYCLE_PROFILER_h
+#define VBS_CYCLE_PROFILER_h
+
+#include <stdint.h>
+#include <istream>
+#include <string>
+#include <vector>
+
+class VbsCycleProfiler
+{
+public:
+    struct Function
+    {
+        std::string Name;
+        uint32_t Address; // bytes
+        bool Interrupt;   // __vector_N, entered without a call
+        unsigned long Calls;
+        uint64_t Cycles;
+        uint64_t MaxCycles;
+    };
+
+private:
+    struct Frame
+    {
+        int Function;
+        uint16_t Sp; // right after the return address was pushed
+        uint64_t Start;
+    };
+    
+    std::vector<Function> _functions;
+    std::vector<int> _entries; // function index by word address, -1 if none
+    std::vector<Frame> _stack;
+    uint32_t _lastPc = 0;
+
+public:
+    // Picks functions from the output of `avr-nm -C --defined-only`: a pattern is a name without the
+    // parameter list (loop, analogRead), or a prefix ending in * (VbsBigRedButton::*, __vector_*)
+    int AddFunctions(std::istream& symbols, const std::vector<std::string>& patterns);
+    
+    // After every instruction: program counter (bytes), stack pointer, data memory, cycle count
+    void Step(const uint32_t pc, const uint16_t sp, const uint8_t* data, const uint64_t cycle);
+    
+    // Zeroes the numbers but keeps track of the functions running right now
+    void ClearCounters();
+    
+    // Zeroes the numbers and forgets the running functions, for a new run from reset
+    void Reset();
+    
+    const std::vector<Function>& GetFunctions() const { return _functions; }
+    const Function* Find(const std::string& name) const;
+};
+
+#endif
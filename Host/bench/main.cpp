@@ -0,0 +1,265 @@
+/*
+    main.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    brb-bench-avr: runs the firmware built for the Leonardo in simavr, cycle by cycle, once for every
+    program, and prints the cycles per loop() and per library function. The button on A0 is an ADC
+    input pressed by a fixed script, the program switches are driven on A1/A2. USB has no host, so the
+    device stays unconfigured and USB_Send() returns before touching the endpoint: the cost of sending
+    reports is NOT measured here. The host build measures it in time and packets instead (the
+    vendor-latency test, the UsbPackets/UsbWaits counters of Shim.h), not in cycles.
+*/
+
+#include "VbsCycleProfiler.h"
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/avr_adc.h>
+#include <simavr/avr_ioport.h>
+
+#define FREQUENCY 16000000UL
+#define BUTTON_OPEN 4880    // mV (1000 of 1023)
+#define BUTTON_CLOSED 100   // mV (20 of 1023)
+#define BUTTON_TRANSITION 400 // us
+#define BUTTON_UPDATE 50    // us
+
+// Leonardo pins of the sketch: A0 is ADC7 (PF7), A2 and A1 are PF5 and PF6
+#define BUTTON_ADC ADC_IRQ_ADC7
+#define SWITCH_1_PIN 5
+#define SWITCH_2_PIN 6
+
+struct Options
+{
+    std::string Firmware;
+    std::string Nm = "avr-nm";
+    int Program = -1; // all
+    unsigned long Time = 8000;   // ms
+    unsigned long WarmUp = 500;  // ms (setup() and the calibration are not counted)
+    int Rows = 30;
+};
+
+// Presses of every run (ms): clicks, a double click, long presses, a burst of taps
+struct Press
+{
+    unsigned long Start;
+    unsigned long Length;
+};
+
+static const Press SCRIPT[] = {
+    { 1000, 100 },
+    { 2000, 80 }, { 2200, 80 },
+    { 3000, 1500 },
+    { 5000, 900 }, { 6100, 60 }, { 6250, 60 },
+    { 6600, 60 }, { 6750, 250 }, { 7200, 60 },
+};
+
+static const char* DEFAULT_PATTERNS[] = {
+    "loop", "VbsBigRedButton::*", "VbsKeyboard::*", "VbsClockSync::*",
+    "analogRead", "analogWrite", "digitalRead", "micros", "millis", "USB_Send", "USB_SendSpace", "__vector_*",
+};
+
+static uint64_t usToCycles(const uint64_t us)
+{
+    return us * (FREQUENCY / 1000000);
+}
+
+// Button voltage at the time, with a linear transition on every edge (presses are longer than that)
+static uint32_t buttonVoltage(const uint64_t us)
+{
+    const uint32_t swing = BUTTON_OPEN - BUTTON_CLOSED;
+    for (const Press& press : SCRIPT)
+    {
+        const uint64_t start = (uint64_t)press.Start * 1000;
+        const uint64_t end = start + (uint64_t)press.Length * 1000;
+        if (us < start) break;
+        if (us < end)
+        {
+            const uint64_t closing = us - start;
+            return closing >= BUTTON_TRANSITION ? BUTTON_CLOSED : BUTTON_OPEN - swing * closing / BUTTON_TRANSITION;
+        }
+        if (us - end < BUTTON_TRANSITION)
+        {
+            return BUTTON_CLOSED + swing * (us - end) / BUTTON_TRANSITION;
+        }
+    }
+    return BUTTON_OPEN;
+}
+
+static avr_cycle_count_t updateButton(avr_t* avr, avr_cycle_count_t when, void* param)
+{
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, BUTTON_ADC), buttonVoltage(when / (FREQUENCY / 1000000)));
+    return when + usToCycles(BUTTON_UPDATE);
+}
+
+static bool loadSymbols(const Options& options, const std::vector<std::string>& patterns, VbsCycleProfiler& profiler)
+{
+    const std::string command = options.Nm + " -C --defined-only '" + options.Firmware + "'";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) return false;
+    
+    std::string output;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    {
+        output.append(buffer, length);
+    }
+    if (pclose(pipe) != 0) return false;
+    
+    std::istringstream symbols(output);
+    return profiler.AddFunctions(symbols, patterns) > 0;
+}
+
+static bool runProgram(const Options& options, elf_firmware_t& firmware, const int program, VbsCycleProfiler& profiler)
+{
+    avr_t* avr = avr_make_mcu_by_name("atmega32u4");
+    if (!avr)
+    {
+        fprintf(stderr, "brb-bench-avr: simavr has no atmega32u4\n");
+        return false;
+    }
+    avr_init(avr);
+    profiler.Reset();
+    avr_load_firmware(avr, &firmware);
+    avr->frequency = FREQUENCY;
+    avr->vcc = 5000;
+    avr->avcc = 5000;
+    avr->aref = 5000;
+    
+    // Switches pull their pins low when on
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('F'), SWITCH_1_PIN), (program & 1) ? 0 : 1);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('F'), SWITCH_2_PIN), (program & 2) ? 0 : 1);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, BUTTON_ADC), BUTTON_OPEN);
+    avr_cycle_timer_register(avr, usToCycles(BUTTON_UPDATE), updateButton, nullptr);
+    
+    const uint64_t warmUp = usToCycles((uint64_t)options.WarmUp * 1000);
+    const uint64_t end = usToCycles((uint64_t)options.Time * 1000);
+    bool counting = false;
+    int state = cpu_Running;
+    while (avr->cycle < end && state != cpu_Done && state != cpu_Crashed)
+    {
+        state = avr_run(avr);
+        profiler.Step(avr->pc, avr->data[R_SPL] | (avr->data[R_SPH] << 8), avr->data, avr->cycle);
+        if (!counting && avr->cycle >= warmUp)
+        {
+            profiler.ClearCounters();
+            counting = true;
+        }
+    }
+    avr_terminate(avr);
+    
+    if (state == cpu_Crashed || state == cpu_Done)
+    {
+        fprintf(stderr, "brb-bench-avr: program %d: the firmware stopped (%s)\n", program, state == cpu_Crashed ? "crashed" : "done");
+        return false;
+    }
+    return true;
+}
+
+static void printProgram(const Options& options, const int program, const VbsCycleProfiler& profiler)
+{
+    const double total = usToCycles((uint64_t)(options.Time - options.WarmUp) * 1000);
+    const VbsCycleProfiler::Function* loop = profiler.Find("loop");
+    printf("program %d:", program);
+    if (loop && loop->Calls > 0)
+    {
+        const double perCall = (double)loop->Cycles / loop->Calls;
+        printf(" %lu loop() calls, %.0f cycles per loop() (%.1f us), %llu max, %.0f cycles per iteration with the main loop\n",
+            loop->Calls, perCall, perCall * 1000000 / FREQUENCY, (unsigned long long)loop->MaxCycles, total / loop->Calls);
+    }
+    else
+    {
+        printf(" loop() not found or never called\n");
+    }
+    
+    std::vector<VbsCycleProfiler::Function> functions = profiler.GetFunctions();
+    std::sort(functions.begin(), functions.end(), [](const VbsCycleProfiler::Function& a, const VbsCycleProfiler::Function& b)
+    {
+        return a.Cycles > b.Cycles;
+    });
+    
+    printf("    %10s %12s %12s %7s  %s\n", "calls", "cycles/call", "max", "time", "function (inclusive)");
+    int rows = 0;
+    for (const auto& function : functions)
+    {
+        if (function.Calls == 0 || rows++ == options.Rows) continue;
+        printf("    %10lu %12.0f %12llu %6.2f%%  %s\n", function.Calls, (double)function.Cycles / function.Calls,
+            (unsigned long long)function.MaxCycles, function.Cycles * 100.0 / total, function.Name.c_str());
+    }
+    printf("\n");
+}
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: brb-bench-avr [options] firmware.elf\n"
+        "  --nm PATH          avr-nm to read the symbols with (default: avr-nm)\n"
+        "  --program N        only this program (0-3, default: all of them)\n"
+        "  --time MS          simulated time of a run (default: 8000, the button script takes 7300)\n"
+        "  --warm-up MS       not counted at the start of a run (default: 500)\n"
+        "  --rows N           functions to list per program (default: 30)\n"
+        "  --function NAME    profile this function too (a name without parameters, or a prefix ending in *)\n");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    std::vector<std::string> patterns(std::begin(DEFAULT_PATTERNS), std::end(DEFAULT_PATTERNS));
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--nm" && hasValue) options.Nm = argv[++i];
+        else if (arg == "--program" && hasValue) options.Program = atoi(argv[++i]);
+        else if (arg == "--time" && hasValue) options.Time = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--warm-up" && hasValue) options.WarmUp = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--rows" && hasValue) options.Rows = atoi(argv[++i]);
+        else if (arg == "--function" && hasValue) patterns.push_back(argv[++i]);
+        else if (arg[0] != '-' && options.Firmware.empty()) options.Firmware = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (options.Firmware.empty() || options.Program > 3 || options.WarmUp >= options.Time)
+    {
+        usage();
+        return 2;
+    }
+    
+    elf_firmware_t firmware;
+    memset(&firmware, 0, sizeof(firmware));
+    if (elf_read_firmware(options.Firmware.c_str(), &firmware) != 0)
+    {
+        fprintf(stderr, "brb-bench-avr: cannot load %s\n", options.Firmware.c_str());
+        return 1;
+    }
+    
+    VbsCycleProfiler profiler;
+    if (!loadSymbols(options, patterns, profiler))
+    {
+        fprintf(stderr, "brb-bench-avr: no symbols from %s (is %s there?)\n", options.Firmware.c_str(), options.Nm.c_str());
+        return 1;
+    }
+    
+    printf("%s at %lu MHz, %lu ms per program after %lu ms warm-up\n", options.Firmware.c_str(), FREQUENCY / 1000000,
+        options.Time - options.WarmUp, options.WarmUp);
+    printf("USB is not configured (no host in simavr): sending reports is not measured, see the README\n\n");
+    for (int program = 0; program < 4; program++)
+    {
+        if (options.Program >= 0 && program != options.Program) continue;
+        if (!runProgram(options, firmware, program, profiler)) return 1;
+        printProgram(options, program, profiler);
+    }
+    return 0;
+}
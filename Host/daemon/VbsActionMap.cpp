@@ -0,0 +1,206 @@
+/*
+    VbsActionMap.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsActionMap.h"
+#include <ctype.h>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <strings.h>
+
+// Number in decimal or 0x hex, -1 if not a number
+static int parseNumber(const std::string& text)
+{
+    if (text.empty()) return -1;
+    char* end;
+    const long value = strtol(text.c_str(), &end, 0);
+    return (*end == '\0' && value >= 0 && value <= 0xFFFF) ? (int)value : -1;
+}
+
+static std::string restOfLine(std::istringstream& words)
+{
+    std::string rest;
+    std::getline(words, rest);
+    const size_t first = rest.find_first_not_of(" \t");
+    const size_t last = rest.find_last_not_of(" \t\r");
+    return first == std::string::npos ? "" : rest.substr(first, last - first + 1);
+}
+
+int VbsActionMap::KeyCode(const std::string& name)
+{
+    // (Single characters are names, 1 is the key and not the code 1)
+    const int number = name.size() > 1 ? parseNumber(name) : -1;
+    if (number >= 0) return number <= 0xFF ? number : -1;
+    
+    if (name.size() == 1 && isalpha((unsigned char)name[0])) return 0x04 + (toupper((unsigned char)name[0]) - 'A');
+    if (name.size() == 1 && name[0] >= '1' && name[0] <= '9') return 0x1E + (name[0] - '1');
+    if (name == "0") return 0x27;
+    if ((name[0] == 'F' || name[0] == 'f') && name.size() <= 3)
+    {
+        const int function = parseNumber(name.substr(1));
+        if (function >= 1 && function <= 12) return 0x3A + function - 1;
+        if (function >= 13 && function <= 24) return 0x68 + function - 13;
+    }
+    
+    static const struct { const char* Name; int Code; } keys[] = {
+        { "ENTER", 0x28 }, { "ESCAPE", 0x29 }, { "BACKSPACE", 0x2A }, { "TAB", 0x2B }, { "SPACE", 0x2C },
+        { "PRINT_SCREEN", 0x46 }, { "SCROLL_LOCK", 0x47 }, { "PAUSE", 0x48 }
+    };
+    for (const auto& key : keys)
+    {
+        if (strcasecmp(name.c_str(), key.Name) == 0) return key.Code;
+    }
+    return -1;
+}
+
+int VbsActionMap::SystemCode(const std::string& name)
+{
+    const int number = parseNumber(name);
+    if (number >= 0) return number;
+    
+    if (strcasecmp(name.c_str(), "POWER") == 0) return 0x81;
+    if (strcasecmp(name.c_str(), "SLEEP") == 0) return 0x82;
+    if (strcasecmp(name.c_str(), "WAKE") == 0) return 0x83;
+    return -1;
+}
+
+int VbsActionMap::BusEventCode(const std::string& name)
+{
+    // BUS_EVENT_* in VbsButtonBus.h
+    static const char* const types[] = { "press", "release", "click", "double", "long", "longdouble" };
+    for (int i = 0; i < 6; i++)
+    {
+        if (strcasecmp(name.c_str(), types[i]) == 0) return i + 1;
+    }
+    return parseNumber(name);
+}
+
+bool VbsActionMap::Load(std::istream& config, std::string& error)
+{
+    std::string line;
+    int number = 0;
+    while (std::getline(config, line))
+    {
+        number++;
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string event;
+        if (!(words >> event)) continue;
+        
+        VbsAction action;
+        action.Code = ACTION_ANY;
+        action.Value = ACTION_ANY;
+        action.Kind = ACTION_RUN;
+        action.Line = number;
+        
+        // Event and its code
+        std::string code;
+        std::string value;
+        int type = 0;
+        while (type < EVENT_TYPE_COUNT && event != VbsReportDecoder::TypeName((VbsEventType)type)) type++;
+        action.Event = (VbsEventType)type;
+        
+        bool valid = true;
+        switch (action.Event)
+        {
+            case EVENT_KEY_DOWN:
+            case EVENT_KEY_UP:
+                valid = (bool)(words >> code) && (code == "*" || (action.Code = KeyCode(code)) >= 0);
+                break;
+            case EVENT_SYSTEM_DOWN:
+            case EVENT_SYSTEM_UP:
+                valid = (bool)(words >> code) && (code == "*" || (action.Code = SystemCode(code)) >= 0);
+                break;
+            case EVENT_BUTTON_DOWN:
+            case EVENT_BUTTON_UP:
+                valid = (bool)(words >> code) && (code == "*" || ((action.Code = parseNumber(code)) >= 1 && action.Code <= 8));
+                break;
+            case EVENT_PROGRAM:
+                // (The program index is the value of the event)
+                valid = (bool)(words >> code) && (code == "*" || ((action.Value = parseNumber(code)) >= 0 && action.Value <= 3));
+                break;
+            case EVENT_TAP_PATTERN:
+                valid = (bool)(words >> code) && (code == "*" || (action.Code = parseNumber(code)) >= 0);
+                break;
+            case EVENT_BUS:
+                valid = (bool)(words >> code >> value) &&
+                    (code == "*" || (action.Code = parseNumber(code)) >= 0) &&
+                    (value == "*" || (action.Value = BusEventCode(value)) >= 0);
+                break;
+            case EVENT_VELOCITY:
+            case EVENT_PRESS_TIME:
+            case EVENT_FIRST:
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        
+        // Action and its arguments
+        std::string kind;
+        if (valid && words >> kind)
+        {
+            if (kind == "run") action.Kind = ACTION_RUN;
+            else if (kind == "play") action.Kind = ACTION_PLAY;
+            else if (kind == "socket") action.Kind = ACTION_SOCKET;
+            else valid = false;
+            
+            if (action.Kind == ACTION_SOCKET)
+            {
+                valid = valid && (bool)(words >> action.Target);
+                action.Text = restOfLine(words);
+            }
+            else
+            {
+                action.Target = restOfLine(words);
+                valid = valid && !action.Target.empty();
+            }
+        }
+        else
+        {
+            valid = false;
+        }
+        
+        if (!valid)
+        {
+            error = "line " + std::to_string(number) + ": invalid action: " + line;
+            return false;
+        }
+        _actions.push_back(action);
+    }
+    return true;
+}
+
+bool VbsActionMap::LoadFile(const std::string& path, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!Load(file, error))
+    {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+void VbsActionMap::Match(const VbsEvent& event, std::vector<const VbsAction*>& actions) const
+{
+    for (const VbsAction& action : _actions)
+    {
+        if (action.Event != event.Type) continue;
+        if (action.Code != ACTION_ANY && action.Code != event.Code) continue;
+        if (action.Value != ACTION_ANY && action.Value != event.Value) continue;
+        actions.push_back(&action);
+    }
+}
+
+const std::vector<VbsAction>& VbsActionMap::GetActions() const
+{
+    return _actions;
+}
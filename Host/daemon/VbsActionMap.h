@@ -0,0 +1,77 @@
+/*
+    VbsActionMap.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    What the daemon does on each event. One action per line, # starts a comment:
+    
+        <event> <action> <argument>
+    
+    Events (* matches any code):
+        key <name|code>         key pressed (F13, A, 1, ENTER, 0x68 ...), keyup for the release
+        system <name|code>      system key pressed (SLEEP, POWER, WAKE, 0x82 ...), systemup for the release
+        button <1-8>            gamepad button pressed, buttonup for the release
+        program <0-3>           program switches changed
+        tap <pattern>           tap pattern recognized
+        bus <satellite> <type>  satellite event, type: press release click double long longdouble
+        velocity                press velocity report
+        time                    press timestamp report
+        first                   the button pressed first in a round (with timestamps, see VbsArbiter.h)
+    
+    Actions:
+        run <command>           run with sh -c
+        play <file>             play a sound file with the player command
+        socket <path> [<text>]  write a line to a Unix domain socket (the event itself without a text)
+    
+    Commands get the event in BRB_DEVICE, BRB_EVENT, BRB_CODE, BRB_VALUE and BRB_TIME.
+*/
+
+#ifndef VBS_ACTION_MAP_h
+#define VBS_ACTION_MAP_h
+
+#include "VbsReportDecoder.h"
+#include <istream>
+#include <string>
+#include <vector>
+
+#define ACTION_ANY -1
+
+enum VbsActionKind
+{
+    ACTION_RUN,
+    ACTION_PLAY,
+    ACTION_SOCKET
+};
+
+struct VbsAction
+{
+    VbsEventType Event;
+    int Code;   // or ACTION_ANY
+    int Value;  // bus event type, or ACTION_ANY
+    VbsActionKind Kind;
+    std::string Target; // command, sound file or socket path
+    std::string Text;   // socket only
+    int Line;
+};
+
+class VbsActionMap
+{
+private:
+    std::vector<VbsAction> _actions;
+    
+public:
+    bool Load(std::istream& config, std::string& error);
+    bool LoadFile(const std::string& path, std::string& error);
+    
+    // Appends the actions of the event, in the order of the configuration
+    void Match(const VbsEvent& event, std::vector<const VbsAction*>& actions) const;
+    
+    const std::vector<VbsAction>& GetActions() const;
+    
+    // Key, system key and bus event type codes by name (or number), -1 if unknown
+    static int KeyCode(const std::string& name);
+    static int SystemCode(const std::string& name);
+    static int BusEventCode(const std::string& name);
+};
+
+#endif
@@ -0,0 +1,506 @@
+/*
+    VbsDaemon.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsDaemon.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <linux/hidraw.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char** environ;
+
+// Signals handled through the signalfd
+static void daemonSignals(sigset_t* set)
+{
+    sigemptyset(set);
+    sigaddset(set, SIGINT);
+    sigaddset(set, SIGTERM);
+    sigaddset(set, SIGUSR1);
+    sigaddset(set, SIGCHLD);
+}
+
+static std::string shellQuote(const std::string& text)
+{
+    std::string quoted = "'";
+    for (const char c : text)
+    {
+        if (c == '\'') quoted += "'\\''";
+        else quoted += c;
+    }
+    return quoted + "'";
+}
+
+// Starts sh -c with the signals of the child back to normal (the daemon blocks them for the signalfd)
+static bool spawnShell(const std::string& command, const std::vector<std::string>& environment)
+{
+    std::vector<char*> env;
+    for (char** variable = environ; *variable; variable++) env.push_back(*variable);
+    for (const std::string& variable : environment) env.push_back(const_cast<char*>(variable.c_str()));
+    env.push_back(NULL);
+    
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+    sigset_t defaults;
+    daemonSignals(&defaults);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    
+    char* argv[] = { const_cast<char*>("sh"), const_cast<char*>("-c"), const_cast<char*>(command.c_str()), NULL };
+    pid_t pid;
+    const int result = posix_spawn(&pid, "/bin/sh", NULL, &attributes, argv, env.data());
+    posix_spawnattr_destroy(&attributes);
+    return result == 0;
+}
+
+// KEY=value lines of a uevent file
+static std::map<std::string, std::string> readUevent(const std::string& path)
+{
+    std::map<std::string, std::string> values;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const size_t equals = line.find('=');
+        if (equals != std::string::npos) values[line.substr(0, equals)] = line.substr(equals + 1);
+    }
+    return values;
+}
+
+uint64_t VbsDaemon::Now()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+VbsDaemon::VbsDaemon(const VbsActionMap& actions, const Options& options) :
+    _actions(actions),
+    _options(options),
+    _spawner(spawnShell),
+    _arbiter((uint64_t)options.ArbitrationWindow * 1000)
+{
+    _latency.reserve(LATENCY_SAMPLES);
+}
+
+VbsDaemon::~VbsDaemon()
+{
+    while (!_devices.empty()) closeDevice(_devices.begin()->first);
+    if (_inotify >= 0) close(_inotify);
+    if (_signals >= 0)
+    {
+        close(_signals);
+        sigset_t set;
+        daemonSignals(&set);
+        sigprocmask(SIG_UNBLOCK, &set, NULL);
+    }
+    if (_epoll >= 0) close(_epoll);
+}
+
+bool VbsDaemon::watch(const int fd)
+{
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool VbsDaemon::Start(std::string& error)
+{
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll < 0)
+    {
+        error = std::string("epoll: ") + strerror(errno);
+        return false;
+    }
+    
+    if (_options.HandleSignals)
+    {
+        sigset_t set;
+        daemonSignals(&set);
+        sigprocmask(SIG_BLOCK, &set, NULL);
+        _signals = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (_signals < 0 || !watch(_signals))
+        {
+            error = std::string("signalfd: ") + strerror(errno);
+            return false;
+        }
+    }
+    
+    if (_options.Discover)
+    {
+        // New nodes show up in /dev, and get their permissions a moment later
+        _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify < 0 || inotify_add_watch(_inotify, "/dev", IN_CREATE | IN_ATTRIB) < 0 || !watch(_inotify))
+        {
+            error = std::string("inotify: ") + strerror(errno);
+            return false;
+        }
+        Scan();
+    }
+    return true;
+}
+
+void VbsDaemon::Scan()
+{
+    DIR* directory = opendir("/sys/class/hidraw");
+    if (!directory) return;
+    
+    while (dirent* entry = readdir(directory))
+    {
+        const std::string node = entry->d_name;
+        if (node.compare(0, 6, "hidraw") != 0) continue;
+        
+        bool open = false;
+        for (const auto& device : _devices) open |= device.second.Node == node;
+        if (open) continue;
+        
+        // HID_ID=<bus>:<vendor>:<product>
+        std::map<std::string, std::string> uevent = readUevent("/sys/class/hidraw/" + node + "/device/uevent");
+        unsigned int bus, vendor, product;
+        if (sscanf(uevent["HID_ID"].c_str(), "%x:%x:%x", &bus, &vendor, &product) != 3) continue;
+        if (vendor != _options.VendorId || product != _options.ProductId) continue;
+        
+        // Both interfaces of a button have the same physical path up to /input<n>
+        std::string name = uevent["HID_PHYS"];
+        const size_t input = name.rfind("/input");
+        if (input != std::string::npos) name.erase(input);
+        if (name.empty()) name = node;
+        
+        // (Writing the clock sync feature report needs write access)
+        int fd = ::open(("/dev/" + node).c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0 && errno == EACCES) fd = ::open(("/dev/" + node).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+        {
+            // (Retried when udev changes the permissions)
+            if (_options.Verbose) fprintf(stderr, "brb-daemon: /dev/%s: %s\n", node.c_str(), strerror(errno));
+            continue;
+        }
+        if (AddDevice(fd, node, name, true) && _options.Verbose) fprintf(stderr, "brb-daemon: %s (%s) opened\n", node.c_str(), name.c_str());
+    }
+    closedir(directory);
+}
+
+bool VbsDaemon::AddDevice(const int fd, const std::string& node, const std::string& name, const bool sync)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (!watch(fd))
+    {
+        close(fd);
+        return false;
+    }
+    Device& device = _devices[fd];
+    device.Node = node;
+    device.Name = name;
+    device.Decoder.Reset();
+    device.Sync = sync;
+    device.SyncFailures = 0;
+    return true;
+}
+
+size_t VbsDaemon::GetDeviceCount() const
+{
+    return _devices.size();
+}
+
+void VbsDaemon::closeDevice(const int fd)
+{
+    const auto device = _devices.find(fd);
+    if (device == _devices.end()) return;
+    
+    if (_options.Verbose) fprintf(stderr, "brb-daemon: %s (%s) closed\n", device->second.Node.c_str(), device->second.Name.c_str());
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    _devices.erase(device);
+}
+
+void VbsDaemon::readDevice(const int fd, const uint64_t arrival)
+{
+    Device& device = _devices[fd];
+    std::vector<VbsEvent> events;
+    uint8_t report[256];
+    for (;;)
+    {
+        const ssize_t size = read(fd, report, sizeof(report));
+        if (size < 0 && errno == EINTR) continue;
+        if (size < 0 && errno == EAGAIN) return;
+        if (size <= 0)
+        {
+            // Unplugged (ENODEV), or the other end of a stand-in closed
+            closeDevice(fd);
+            return;
+        }
+        
+        events.clear();
+        device.Decoder.Decode(report, size, events);
+        for (const VbsEvent& event : events) dispatch(device.Name, event, arrival);
+    }
+}
+
+void VbsDaemon::dispatch(const std::string& device, const VbsEvent& event, const uint64_t arrival)
+{
+    if (_options.Verbose)
+    {
+        fprintf(stderr, "brb-daemon: %s %s %u %u %u\n", device.c_str(), VbsReportDecoder::TypeName(event.Type),
+            event.Code, event.Value, event.Time);
+    }
+    if (_eventHandler) _eventHandler(device, event, arrival);
+    
+    // Presses for the arbitration, the timestamps where the buttons send them
+    switch (event.Type)
+    {
+        case EVENT_KEY_DOWN:
+        case EVENT_SYSTEM_DOWN:
+        case EVENT_BUTTON_DOWN:
+            _arbiter.AddPress(device, arrival / 1000);
+            break;
+        case EVENT_PRESS_TIME:
+            _arbiter.AddPressTime(device, event.Time, arrival / 1000);
+            break;
+        default:
+            break;
+    }
+    
+    std::vector<const VbsAction*> actions;
+    _actions.Match(event, actions);
+    if (actions.empty()) return;
+    
+    const std::vector<std::string> environment = {
+        "BRB_DEVICE=" + device,
+        std::string("BRB_EVENT=") + VbsReportDecoder::TypeName(event.Type),
+        "BRB_CODE=" + std::to_string(event.Code),
+        "BRB_VALUE=" + std::to_string(event.Value),
+        "BRB_TIME=" + std::to_string(event.Time)
+    };
+    
+    for (const VbsAction* action : actions)
+    {
+        bool ok = false;
+        switch (action->Kind)
+        {
+            case ACTION_RUN:
+                ok = _spawner(action->Target, environment);
+                break;
+            case ACTION_PLAY:
+                ok = _spawner(_options.Player + " " + shellQuote(action->Target), environment);
+                break;
+            case ACTION_SOCKET:
+                ok = sendToSocket(action->Target, !action->Text.empty() ? action->Text :
+                    std::string(VbsReportDecoder::TypeName(event.Type)) + " " + std::to_string(event.Code) + " " +
+                    std::to_string(event.Value) + " " + std::to_string(event.Time) + " " + device);
+                break;
+        }
+        if (ok) recordLatency(arrival);
+        else fprintf(stderr, "brb-daemon: action of line %d failed: %s\n", action->Line, strerror(errno));
+    }
+}
+
+bool VbsDaemon::sendToSocket(const std::string& path, const std::string& line)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+    
+    // Stream listeners are the usual, datagram sockets work too
+    const std::string message = line + "\n";
+    for (const int type : { SOCK_STREAM, SOCK_DGRAM })
+    {
+        const int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        if (connect(fd, (sockaddr*)&address, sizeof(address)) == 0)
+        {
+            const bool sent = send(fd, message.data(), message.size(), MSG_NOSIGNAL | MSG_DONTWAIT) == (ssize_t)message.size();
+            close(fd);
+            return sent;
+        }
+        const int error = errno;
+        close(fd);
+        errno = error;
+        if (error != EPROTOTYPE) return false;
+    }
+    return false;
+}
+
+void VbsDaemon::recordLatency(const uint64_t arrival)
+{
+    const uint64_t elapsed = Now() - arrival;
+    const uint32_t latency = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    if (_latency.size() < LATENCY_SAMPLES) _latency.push_back(latency);
+    else _latency[_latencyCount % LATENCY_SAMPLES] = latency;
+    _latencyCount++;
+    _latencyTotal += latency;
+    _latencyMax = std::max(_latencyMax, latency);
+}
+
+VbsLatencyStats VbsDaemon::GetLatency() const
+{
+    VbsLatencyStats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.Count = _latencyCount;
+    if (_latency.empty()) return stats;
+    
+    std::vector<uint32_t> sorted = _latency;
+    std::sort(sorted.begin(), sorted.end());
+    stats.Min = sorted.front() / 1000.0;
+    stats.Mean = _latencyTotal / _latencyCount / 1000.0;
+    stats.Median = sorted[sorted.size() / 2] / 1000.0;
+    stats.P99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)] / 1000.0;
+    stats.Max = _latencyMax / 1000.0;
+    return stats;
+}
+
+void VbsDaemon::PrintLatency(FILE* file) const
+{
+    const VbsLatencyStats stats = GetLatency();
+    fprintf(file, "brb-daemon: %llu actions, latency min %.1f us, mean %.1f us, median %.1f us, 99%% %.1f us, max %.1f us\n",
+        (unsigned long long)stats.Count, stats.Min, stats.Mean, stats.Median, stats.P99, stats.Max);
+}
+
+void VbsDaemon::handleSignals()
+{
+    signalfd_siginfo info;
+    while (read(_signals, &info, sizeof(info)) == sizeof(info))
+    {
+        switch (info.ssi_signo)
+        {
+            case SIGUSR1: PrintLatency(stderr); break;
+            case SIGCHLD: while (waitpid(-1, NULL, WNOHANG) > 0) {} break;
+            default: _stop = true; break;
+        }
+    }
+}
+
+void VbsDaemon::handleInotify()
+{
+    alignas(inotify_event) char buffer[4096];
+    bool rescan = false;
+    for (;;)
+    {
+        const ssize_t size = read(_inotify, buffer, sizeof(buffer));
+        if (size <= 0) break;
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event* event = (const inotify_event*)(buffer + offset);
+            if (event->len > 0 && strncmp(event->name, "hidraw", 6) == 0) rescan = true;
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+    if (rescan) Scan();
+}
+
+void VbsDaemon::syncClocks()
+{
+    for (auto& entry : _devices)
+    {
+        // (The keyboard interface of a button does not have the report, it is left alone after a few tries)
+        Device& device = entry.second;
+        if (!device.Sync || device.SyncFailures >= 3) continue;
+        
+        // The button takes the time of arrival as the time of this timestamp
+        const uint32_t host = (uint32_t)VbsArbiter::HostClock();
+        uint8_t report[5] = { HID_REPORTID_CLOCK_SYNC, (uint8_t)host, (uint8_t)(host >> 8), (uint8_t)(host >> 16), (uint8_t)(host >> 24) };
+        if (ioctl(entry.first, HIDIOCSFEATURE(sizeof(report)), report) < 0) device.SyncFailures++;
+        else device.SyncFailures = 0;
+    }
+}
+
+void VbsDaemon::pollArbiter()
+{
+    std::vector<VbsPress> ranking;
+    if (!_arbiter.Poll(VbsArbiter::HostClock(), ranking) || ranking.empty()) return;
+    
+    VbsEvent event;
+    memset(&event, 0, sizeof(event));
+    event.Type = EVENT_FIRST;
+    event.Code = ranking.size() > 1 ? (uint16_t)std::min<uint64_t>(ranking[1].Time - ranking[0].Time, 65535) : 65535;
+    event.Value = (uint8_t)std::min<size_t>(ranking.size(), 255);
+    event.Time = (uint32_t)ranking[0].Time;
+    dispatch(ranking[0].Device, event, Now());
+}
+
+int VbsDaemon::RunOnce(const int timeout)
+{
+    if (_stop) return -1;
+    
+    // Wake up for the next clock sync and the end of the arbitration round too
+    const uint64_t now = VbsArbiter::HostClock();
+    int64_t wait = timeout;
+    if (_options.SyncPeriod > 0)
+    {
+        if (now >= _nextSync)
+        {
+            syncClocks();
+            _nextSync = now + (uint64_t)_options.SyncPeriod * 1000;
+        }
+        const int64_t untilSync = (int64_t)(_nextSync - now + 999) / 1000;
+        if (wait < 0 || untilSync < wait) wait = untilSync;
+    }
+    if (_arbiter.GetDeadline() != 0)
+    {
+        const int64_t untilDeadline = _arbiter.GetDeadline() > now ? (int64_t)(_arbiter.GetDeadline() - now + 999) / 1000 : 0;
+        if (wait < 0 || untilDeadline < wait) wait = untilDeadline;
+    }
+    
+    epoll_event events[16];
+    const int count = epoll_wait(_epoll, events, 16, (int)wait);
+    const uint64_t arrival = Now();
+    if (count < 0) return errno == EINTR ? 0 : -1;
+    
+    for (int i = 0; i < count; i++)
+    {
+        const int fd = events[i].data.fd;
+        if (fd == _signals) handleSignals();
+        else if (fd == _inotify) handleInotify();
+        else if (_devices.count(fd)) readDevice(fd, arrival);
+    }
+    pollArbiter();
+    return _stop ? -1 : count;
+}
+
+int VbsDaemon::Run()
+{
+    while (RunOnce(-1) >= 0) {}
+    PrintLatency(stderr);
+    return 0;
+}
+
+void VbsDaemon::Stop()
+{
+    _stop = true;
+}
+
+void VbsDaemon::SetSpawner(Spawner spawner)
+{
+    _spawner = spawner;
+}
+
+void VbsDaemon::SetEventHandler(EventHandler handler)
+{
+    _eventHandler = handler;
+}
@@ -0,0 +1,134 @@
+/*
+    VbsDaemon.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Finds the buttons by USB IDs among the hidraw nodes (also the ones plugged in later), reads
+    and decodes their reports in an epoll loop and dispatches the configured actions. Actions
+    never block the loop: commands are spawned, socket writes do not wait.
+    
+    Latency is measured from the wakeup with the report to the action being dispatched (the
+    command spawned or the line written), SIGUSR1 prints it, as does the end of Run().
+    
+    The host clock is written into the clock sync feature report of every button periodically,
+    so the buttons with press timestamps on take part in the first-press arbitration (VbsArbiter).
+    (Each sync is a control transfer the loop waits for, about a millisecond per button.)
+*/
+
+#ifndef VBS_DAEMON_h
+#define VBS_DAEMON_h
+
+#include "VbsActionMap.h"
+#include "VbsReportDecoder.h"
+#include <VbsArbiter.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#define LATENCY_SAMPLES 4096
+
+struct VbsLatencyStats
+{
+    uint64_t Count;
+    double Min;     // us
+    double Mean;
+    double Median;  // (of the last LATENCY_SAMPLES)
+    double P99;
+    double Max;
+};
+
+class VbsDaemon
+{
+public:
+    struct Options
+    {
+        uint16_t VendorId = 0x2341; // Arduino Leonardo
+        uint16_t ProductId = 0x8036;
+        std::string Player = "aplay -q";
+        bool Discover = true;       // look for the buttons among the hidraw nodes
+        bool HandleSignals = true;  // SIGINT/SIGTERM stop, SIGUSR1 prints the latency, children are reaped
+        int SyncPeriod = 1000;      // ms between clock syncs, 0 = off
+        int ArbitrationWindow = 20; // ms after the first press of a round
+        bool Verbose = false;
+    };
+    
+    // Starts a command (sh -c) with these extra environment variables, false if it could not be started
+    typedef std::function<bool(const std::string& command, const std::vector<std::string>& environment)> Spawner;
+    
+    // Called with every decoded event, before its actions
+    typedef std::function<void(const std::string& device, const VbsEvent& event, uint64_t arrival)> EventHandler;
+    
+private:
+    struct Device
+    {
+        std::string Node;
+        std::string Name;
+        VbsReportDecoder Decoder;
+        bool Sync; // (hidraw node that may have the clock sync report)
+        uint8_t SyncFailures;
+    };
+    
+    const VbsActionMap& _actions;
+    Options _options;
+    Spawner _spawner;
+    EventHandler _eventHandler;
+    
+    int _epoll = -1;
+    int _signals = -1;
+    int _inotify = -1;
+    bool _stop = false;
+    std::map<int, Device> _devices;
+    VbsArbiter _arbiter;
+    uint64_t _nextSync = 0; // us
+    
+    std::vector<uint32_t> _latency; // ns, ring
+    uint64_t _latencyCount = 0;
+    double _latencyTotal = 0;
+    uint32_t _latencyMax = 0;
+    
+    bool watch(const int fd);
+    void closeDevice(const int fd);
+    void readDevice(const int fd, const uint64_t arrival);
+    void handleSignals();
+    void handleInotify();
+    void dispatch(const std::string& device, const VbsEvent& event, const uint64_t arrival);
+    void syncClocks();
+    void pollArbiter();
+    bool sendToSocket(const std::string& path, const std::string& line);
+    void recordLatency(const uint64_t arrival);
+    
+public:
+    VbsDaemon(const VbsActionMap& actions, const Options& options);
+    ~VbsDaemon();
+    VbsDaemon(const VbsDaemon&) = delete;
+    VbsDaemon& operator=(const VbsDaemon&) = delete;
+    
+    bool Start(std::string& error);
+    
+    // Opens the matching hidraw nodes that are not open yet
+    void Scan();
+    
+    // Reads reports from this descriptor too (one report per read, like hidraw), takes ownership
+    // (sync: send clock syncs with the hidraw feature report ioctl)
+    bool AddDevice(const int fd, const std::string& node, const std::string& name, const bool sync = false);
+    size_t GetDeviceCount() const;
+    
+    // One round of the loop (timeout in ms, -1 waits), the number of descriptors handled, -1 once stopped
+    int RunOnce(const int timeout);
+    int Run();
+    void Stop();
+    
+    void SetSpawner(Spawner spawner);
+    void SetEventHandler(EventHandler handler);
+    
+    VbsLatencyStats GetLatency() const;
+    void PrintLatency(FILE* file) const;
+    
+    // CLOCK_MONOTONIC in nanoseconds
+    static uint64_t Now();
+};
+
+#endif
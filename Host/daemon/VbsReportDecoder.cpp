@@ -0,0 +1,132 @@
+/*
+    VbsReportDecoder.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsReportDecoder.h"
+#include <string.h>
+
+static uint32_t readLE32(const uint8_t* data)
+{
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+template <typename T, size_t N>
+static bool contains(const T (&values)[N], const T value)
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        if (values[i] == value) return true;
+    }
+    return false;
+}
+
+static VbsEvent makeEvent(const VbsEventType type, const uint16_t code, const uint8_t value = 0, const uint32_t time = 0)
+{
+    VbsEvent event;
+    event.Type = type;
+    event.Code = code;
+    event.Modifiers = 0;
+    event.Value = value;
+    event.Time = time;
+    return event;
+}
+
+bool VbsReportDecoder::Decode(const uint8_t* data, const size_t size, std::vector<VbsEvent>& events)
+{
+    if (size < 1) return false;
+    
+    switch (data[0])
+    {
+        case HID_REPORTID_KEYBOARD:
+        {
+            // Modifiers, reserved, 6 keys
+            if (size != 9) return false;
+            const uint8_t* keys = data + 3;
+            for (int i = 0; i < 6; i++)
+            {
+                if (_keys[i] && !memchr(keys, _keys[i], 6)) events.push_back(makeEvent(EVENT_KEY_UP, _keys[i]));
+            }
+            for (int i = 0; i < 6; i++)
+            {
+                if (keys[i] && !contains(_keys, keys[i]))
+                {
+                    VbsEvent event = makeEvent(EVENT_KEY_DOWN, keys[i]);
+                    event.Modifiers = data[1];
+                    events.push_back(event);
+                }
+            }
+            memcpy(_keys, keys, 6);
+            return true;
+        }
+        
+        case HID_REPORTID_GENERICDESKTOP:
+        {
+            // 4 keys, 16 bits each
+            if (size != 9) return false;
+            uint16_t keys[4];
+            for (int i = 0; i < 4; i++) keys[i] = data[1 + i * 2] | (data[2 + i * 2] << 8);
+            for (int i = 0; i < 4; i++)
+            {
+                if (_systemKeys[i] && !contains(keys, _systemKeys[i])) events.push_back(makeEvent(EVENT_SYSTEM_UP, _systemKeys[i]));
+            }
+            for (int i = 0; i < 4; i++)
+            {
+                if (keys[i] && !contains(_systemKeys, keys[i])) events.push_back(makeEvent(EVENT_SYSTEM_DOWN, keys[i]));
+            }
+            memcpy(_systemKeys, keys, sizeof(keys));
+            return true;
+        }
+        
+        case HID_REPORTID_GAMEPAD:
+        {
+            // Buttons, program, axis
+            if (size != 4) return false;
+            const uint8_t changed = data[1] ^ _buttons;
+            for (int i = 0; i < 8; i++)
+            {
+                if (changed & (1 << i)) events.push_back(makeEvent((data[1] & (1 << i)) ? EVENT_BUTTON_DOWN : EVENT_BUTTON_UP, i + 1));
+            }
+            _buttons = data[1];
+            if (data[2] != _program) events.push_back(makeEvent(EVENT_PROGRAM, 0, data[2]));
+            _program = data[2];
+            return true;
+        }
+        
+        case HID_REPORTID_VENDOR:
+        {
+            // Type and 7 data bytes
+            if (size != 9) return false;
+            const uint8_t* payload = data + 2;
+            switch (data[1])
+            {
+                case VENDOR_PRESS_VELOCITY: events.push_back(makeEvent(EVENT_VELOCITY, 0, payload[0])); break;
+                case VENDOR_BUS_EVENT: events.push_back(makeEvent(EVENT_BUS, payload[0], payload[1], readLE32(payload + 2))); break;
+                case VENDOR_PRESS_TIME: events.push_back(makeEvent(EVENT_PRESS_TIME, 0, 0, readLE32(payload))); break;
+                case VENDOR_TAP_PATTERN: events.push_back(makeEvent(EVENT_TAP_PATTERN, payload[0])); break;
+                default: break;
+            }
+            return true;
+        }
+        
+        default:
+            return false;
+    }
+}
+
+void VbsReportDecoder::Reset()
+{
+    memset(_keys, 0, sizeof(_keys));
+    memset(_systemKeys, 0, sizeof(_systemKeys));
+    _buttons = 0;
+    _program = -1;
+}
+
+const char* VbsReportDecoder::TypeName(const VbsEventType type)
+{
+    static const char* const names[EVENT_TYPE_COUNT] = {
+        "key", "keyup", "system", "systemup", "button", "buttonup", "program", "velocity", "bus", "time", "tap", "first"
+    };
+    return type < EVENT_TYPE_COUNT ? names[type] : "";
+}
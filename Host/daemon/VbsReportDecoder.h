@@ -0,0 +1,66 @@
+/*
+    VbsReportDecoder.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Turns the input reports of the button (as read from its hidraw nodes) into events. The report
+    IDs come from VbsReportIds.h of the firmware, the layouts are the ones of VbsKeyboard.h, see "Reading the button directly from host
+    software" in the README. Keeps the state of one device, so key reports become presses and
+    releases.
+*/
+
+#ifndef VBS_REPORT_DECODER_h
+#define VBS_REPORT_DECODER_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <VbsReportIds.h>
+
+enum VbsEventType
+{
+    EVENT_KEY_DOWN,     // Code: key (page 0x07), Modifiers
+    EVENT_KEY_UP,
+    EVENT_SYSTEM_DOWN,  // Code: key (page 0x01)
+    EVENT_SYSTEM_UP,
+    EVENT_BUTTON_DOWN,  // Code: gamepad button (1-8)
+    EVENT_BUTTON_UP,
+    EVENT_PROGRAM,      // Value: program index
+    EVENT_VELOCITY,     // Value: 1-255
+    EVENT_BUS,          // Code: satellite id, Value: BUS_EVENT_* type, Time: ms on the master's clock
+    EVENT_PRESS_TIME,   // Time: us on the host clock
+    EVENT_TAP_PATTERN,  // Code: pattern number
+    EVENT_FIRST,        // (not from a report) first press of a round, see VbsArbiter.h. Code: lead over the
+                        // second one (us, up to 65535), Value: buttons in the round, Time: press time (us)
+    EVENT_TYPE_COUNT
+};
+
+struct VbsEvent
+{
+    VbsEventType Type;
+    uint16_t Code;
+    uint8_t Modifiers;
+    uint8_t Value;
+    uint32_t Time;
+};
+
+class VbsReportDecoder
+{
+private:
+    uint8_t _keys[6] = {};
+    uint16_t _systemKeys[4] = {};
+    uint8_t _buttons = 0;
+    int _program = -1;
+    
+public:
+    // Appends the events of one report (starting with the report ID), false if it is not a report of the button
+    bool Decode(const uint8_t* data, const size_t size, std::vector<VbsEvent>& events);
+    
+    // Forget the keys held (device closed)
+    void Reset();
+    
+    // Name of the event type, as used in the configuration and in BRB_EVENT
+    static const char* TypeName(const VbsEventType type);
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*
+    main.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    brb-daemon: runs the configured actions on the events of the buttons, see VbsActionMap.h
+    for the configuration and the Host section of the README.
+*/
+
+#include "VbsActionMap.h"
+#include "VbsDaemon.h"
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+
+static void usage()
+{
+    std::cerr <<
+        "usage: brb-daemon [options] <config>\n"
+        "  --vid HEX         USB vendor ID of the buttons (default 2341)\n"
+        "  --pid HEX         USB product ID of the buttons (default 8036)\n"
+        "  --player COMMAND  sound player of the play actions (default aplay -q)\n"
+        "  --sync MS         period of the clock syncs, 0 turns them off (default 1000)\n"
+        "  --window MS       how long the first-press arbitration waits for the other buttons (default 20)\n"
+        "  --verbose         print the devices and events\n"
+        "SIGUSR1 prints the latency of the actions, so does stopping.\n";
+}
+
+int main(int argc, char** argv)
+{
+    VbsDaemon::Options options;
+    std::string config;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--vid" && hasValue) options.VendorId = strtoul(argv[++i], NULL, 16);
+        else if (arg == "--pid" && hasValue) options.ProductId = strtoul(argv[++i], NULL, 16);
+        else if (arg == "--player" && hasValue) options.Player = argv[++i];
+        else if (arg == "--sync" && hasValue) options.SyncPeriod = atoi(argv[++i]);
+        else if (arg == "--window" && hasValue) options.ArbitrationWindow = atoi(argv[++i]);
+        else if (arg == "--verbose") options.Verbose = true;
+        else if (arg[0] != '-' && config.empty()) config = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (config.empty())
+    {
+        usage();
+        return 2;
+    }
+    
+    VbsActionMap actions;
+    std::string error;
+    if (!actions.LoadFile(config, error))
+    {
+        std::cerr << "brb-daemon: " << error << "\n";
+        return 1;
+    }
+    
+    VbsDaemon daemon(actions, options);
+    if (!daemon.Start(error))
+    {
+        std::cerr << "brb-daemon: " << error << "\n";
+        return 1;
+    }
+    return daemon.Run();
+}
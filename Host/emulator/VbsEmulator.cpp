@@ -0,0 +1,180 @@
+/*
+    VbsEmulator.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsEmulator.h"
+#include <Shim.h>
+#include <sstream>
+#include <Arduino.h>
+#include <VbsKeyboard.h>
+
+// Entry points of the sketch
+void setup();
+void loop();
+
+VbsEmulator::VbsEmulator()
+{
+}
+
+int VbsEmulator::buttonLevel(const uint64_t now)
+{
+    // Linear transition between the levels, plus a little noise
+    const int from = _pressed ? _openLevel : _closedLevel;
+    const int to = _pressed ? _closedLevel : _openLevel;
+    const uint64_t since = now - _edgeTime;
+    int level = since >= _transitionTime ? to : from + (int)((to - from) * (int64_t)since / (int64_t)_transitionTime);
+    
+    _noise = _noise * 1103515245 + 12345;
+    return level + (int)((_noise >> 16) % 5) - 2;
+}
+
+void VbsEmulator::Start(const uint64_t startTime)
+{
+    Shim::Reset(startTime);
+    Shim::SetAnalogSource([this](uint8_t pin, uint64_t now) {
+        return pin == EMULATOR_PIN_BUTTON ? buttonLevel(now) : 1023;
+    });
+    _pressed = false;
+    _edgeTime = 0;
+    setup();
+}
+
+void VbsEmulator::Run(const uint64_t us)
+{
+    const uint64_t end = Shim::Now() + us;
+    while (Shim::Now() < end)
+    {
+        loop();
+        
+        // (The core calls the serial event handlers between loops, a few us)
+        Shim::Advance(4);
+        if (_idleHandler) _idleHandler();
+    }
+}
+
+void VbsEmulator::SetButton(const bool pressed)
+{
+    if (pressed == _pressed) return;
+    _pressed = pressed;
+    _edgeTime = Shim::Now();
+}
+
+void VbsEmulator::SetProgram(const int program)
+{
+    // Switches pull to ground when on
+    Shim::SetDigital(EMULATOR_PIN_SWITCH_1, (program & 1) ? LOW : HIGH);
+    Shim::SetDigital(EMULATOR_PIN_SWITCH_2, (program & 2) ? LOW : HIGH);
+}
+
+void VbsEmulator::SetLevels(const int open, const int closed)
+{
+    _openLevel = open;
+    _closedLevel = closed;
+}
+
+void VbsEmulator::SetTransitionTime(const uint64_t us)
+{
+    _transitionTime = us > 0 ? us : 1;
+}
+
+void VbsEmulator::SetLeds(const uint8_t mask)
+{
+    Shim::SetReport(Shim::GetInterface(0), HID_REPORT_TYPE_OUTPUT, HID_REPORTID_KEYBOARD, { HID_REPORTID_KEYBOARD, mask });
+}
+
+void VbsEmulator::SetHostClockOffset(const int64_t us)
+{
+    _hostClockOffset = us;
+}
+
+uint32_t VbsEmulator::GetHostTime() const
+{
+    return (uint32_t)(Shim::Now() + _hostClockOffset);
+}
+
+void VbsEmulator::SyncClock()
+{
+    const uint32_t host = GetHostTime();
+    Shim::SetReport(Shim::GetInterface(1), HID_REPORT_TYPE_FEATURE, HID_REPORTID_CLOCK_SYNC, {
+        HID_REPORTID_CLOCK_SYNC, (uint8_t)host, (uint8_t)(host >> 8), (uint8_t)(host >> 16), (uint8_t)(host >> 24)
+    });
+}
+
+void VbsEmulator::SetIdleHandler(std::function<void()> handler)
+{
+    _idleHandler = handler;
+}
+
+bool VbsEmulator::RunScriptLine(const std::string& line, std::string& error)
+{
+    std::istringstream words(line.substr(0, line.find('#')));
+    std::string command;
+    if (!(words >> command)) return true;
+    
+    long a = 0;
+    long b = 0;
+    if (command == "wait" && words >> a)
+    {
+        Run((uint64_t)a * 1000);
+    }
+    else if (command == "press")
+    {
+        SetButton(true);
+    }
+    else if (command == "release")
+    {
+        SetButton(false);
+    }
+    else if (command == "tap" && words >> a)
+    {
+        if (!(words >> b)) b = 0;
+        SetButton(true);
+        Run((uint64_t)a * 1000);
+        SetButton(false);
+        Run((uint64_t)b * 1000);
+    }
+    else if (command == "switch" && words >> a && a >= 0 && a <= 3)
+    {
+        SetProgram((int)a);
+    }
+    else if (command == "leds" && words >> a)
+    {
+        SetLeds((uint8_t)a);
+    }
+    else if (command == "sync")
+    {
+        SyncClock();
+    }
+    else if (command == "level" && words >> a >> b)
+    {
+        SetLevels((int)a, (int)b);
+    }
+    else if (command == "transition" && words >> a && a >= 0)
+    {
+        SetTransitionTime((uint64_t)a);
+    }
+    else
+    {
+        error = "invalid command: " + line;
+        return false;
+    }
+    return true;
+}
+
+bool VbsEmulator::RunScript(std::istream& script, std::string& error)
+{
+    std::string line;
+    int number = 0;
+    while (std::getline(script, line))
+    {
+        number++;
+        if (!RunScriptLine(line, error))
+        {
+            error = "line " + std::to_string(number) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+    VbsEmulator.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Runs the real sketch and libraries on the PC (see Shim.h) and drives the button from a script.
+    
+    Script commands, one per line (times in milliseconds, # starts a comment):
+        wait <ms>               let the sketch run
+        press                   close the button
+        release                 open the button
+        tap <ms> [<pause>]      press, wait, release, wait for the pause
+        switch <program>        set the program switches (0-3)
+        leds <mask>             keyboard LED output report from the host (4 = Scroll Lock)
+        sync                    host writes its clock into the clock sync feature report
+        level <open> <closed>   ADC levels of the button (default 1000 and 20)
+        transition <us>         time the signal takes from one level to the other (default 400)
+*/
+
+#ifndef VBS_EMULATOR_h
+#define VBS_EMULATOR_h
+
+#include <stdint.h>
+#include <functional>
+#include <istream>
+#include <string>
+
+// Pins of the sketch
+#define EMULATOR_PIN_BUTTON     18 // A0
+#define EMULATOR_PIN_SWITCH_1   20 // A2
+#define EMULATOR_PIN_SWITCH_2   19 // A1
+#define EMULATOR_PIN_LIGHT      9
+
+class VbsEmulator
+{
+private:
+    // CONFIG
+    int _openLevel = 1000;
+    int _closedLevel = 20;
+    uint64_t _transitionTime = 400; // us (contact bounce and cable capacitance)
+    int64_t _hostClockOffset = 0; // us
+    
+    // STATE
+    bool _pressed = false;
+    uint64_t _edgeTime = 0;
+    uint32_t _noise = 1;
+    std::function<void()> _idleHandler;
+    
+    int buttonLevel(const uint64_t now);
+    
+public:
+    VbsEmulator();
+    
+    // Resets the simulated board and runs setup() of the sketch
+    void Start(const uint64_t startTime = 0);
+    
+    // Runs loop() of the sketch for this long (in microseconds)
+    void Run(const uint64_t us);
+    
+    void SetButton(const bool pressed);
+    void SetProgram(const int program);
+    void SetLevels(const int open, const int closed);
+    void SetTransitionTime(const uint64_t us);
+    void SetLeds(const uint8_t mask);
+    
+    // Clock sync as the host would do it, the host clock is the virtual clock plus an offset
+    void SetHostClockOffset(const int64_t us);
+    uint32_t GetHostTime() const;
+    void SyncClock();
+    
+    // Called after every loop() (the uhid output uses it to keep up with the wall clock and to
+    // handle the kernel's requests)
+    void SetIdleHandler(std::function<void()> handler);
+    
+    bool RunScriptLine(const std::string& line, std::string& error);
+    bool RunScript(std::istream& script, std::string& error);
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+    VbsUhid.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "VbsUhid.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/uhid.h>
+
+VbsUhid::VbsUhid()
+{
+}
+
+VbsUhid::~VbsUhid()
+{
+    Destroy();
+}
+
+bool VbsUhid::write(const void* event, const size_t size)
+{
+    for (;;)
+    {
+        const ssize_t written = ::write(_fd, event, size);
+        if (written == (ssize_t)size) return true;
+        if (written < 0 && errno == EINTR) continue;
+        return false;
+    }
+}
+
+bool VbsUhid::Create(const std::string& name, const std::string& physical, const std::string& unique, const std::vector<uint8_t>& descriptor)
+{
+    Destroy();
+    if (descriptor.size() > HID_MAX_DESCRIPTOR_SIZE)
+    {
+        errno = EINVAL;
+        return false;
+    }
+    
+    _fd = open("/dev/uhid", O_RDWR | O_CLOEXEC | O_NONBLOCK);
+    if (_fd < 0) return false;
+    
+    uhid_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = UHID_CREATE2;
+    strncpy((char*)event.u.create2.name, name.c_str(), sizeof(event.u.create2.name) - 1);
+    strncpy((char*)event.u.create2.phys, physical.c_str(), sizeof(event.u.create2.phys) - 1);
+    strncpy((char*)event.u.create2.uniq, unique.c_str(), sizeof(event.u.create2.uniq) - 1);
+    memcpy(event.u.create2.rd_data, descriptor.data(), descriptor.size());
+    event.u.create2.rd_size = descriptor.size();
+    event.u.create2.bus = BUS_USB;
+    event.u.create2.vendor = VendorId;
+    event.u.create2.product = ProductId;
+    
+    if (!write(&event, sizeof(event)))
+    {
+        const int error = errno;
+        close(_fd);
+        _fd = -1;
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+void VbsUhid::Destroy()
+{
+    if (_fd < 0) return;
+    
+    uhid_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = UHID_DESTROY;
+    write(&event, sizeof(event));
+    close(_fd);
+    _fd = -1;
+}
+
+int VbsUhid::GetFd() const
+{
+    return _fd;
+}
+
+bool VbsUhid::SendInput(const std::vector<uint8_t>& data)
+{
+    if (_fd < 0 || data.size() > UHID_DATA_MAX) return false;
+    
+    uhid_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = UHID_INPUT2;
+    event.u.input2.size = data.size();
+    memcpy(event.u.input2.data, data.data(), data.size());
+    return write(&event, sizeof(event));
+}
+
+void VbsUhid::Process()
+{
+    if (_fd < 0) return;
+    
+    uhid_event event;
+    for (;;)
+    {
+        memset(&event, 0, sizeof(event));
+        const ssize_t size = read(_fd, &event, sizeof(event));
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) return;
+        
+        switch (event.type)
+        {
+            case UHID_OPEN:
+            case UHID_CLOSE:
+                if (OnOpen) OnOpen(event.type == UHID_OPEN);
+                break;
+            
+            case UHID_OUTPUT:
+                // (Output reports written by the host to the interrupt OUT pipe or with SET_REPORT)
+                if (OnSetReport) OnSetReport(event.u.output.rtype == UHID_FEATURE_REPORT ? 3 : 2,
+                    std::vector<uint8_t>(event.u.output.data, event.u.output.data + event.u.output.size));
+                break;
+            
+            case UHID_GET_REPORT:
+            {
+                std::vector<uint8_t> data;
+                const uint8_t type = event.u.get_report.rtype == UHID_FEATURE_REPORT ? 3 : event.u.get_report.rtype == UHID_OUTPUT_REPORT ? 2 : 1;
+                const bool ok = OnGetReport && OnGetReport(type, event.u.get_report.rnum, data) && data.size() <= UHID_DATA_MAX;
+                
+                const uint32_t id = event.u.get_report.id;
+                memset(&event, 0, sizeof(event));
+                event.type = UHID_GET_REPORT_REPLY;
+                event.u.get_report_reply.id = id;
+                event.u.get_report_reply.err = ok ? 0 : EIO;
+                if (ok)
+                {
+                    event.u.get_report_reply.size = data.size();
+                    memcpy(event.u.get_report_reply.data, data.data(), data.size());
+                }
+                write(&event, sizeof(event));
+                break;
+            }
+            
+            case UHID_SET_REPORT:
+            {
+                const uint8_t type = event.u.set_report.rtype == UHID_FEATURE_REPORT ? 3 : event.u.set_report.rtype == UHID_OUTPUT_REPORT ? 2 : 1;
+                if (OnSetReport) OnSetReport(type, std::vector<uint8_t>(event.u.set_report.data, event.u.set_report.data + event.u.set_report.size));
+                
+                const uint32_t id = event.u.set_report.id;
+                memset(&event, 0, sizeof(event));
+                event.type = UHID_SET_REPORT_REPLY;
+                event.u.set_report_reply.id = id;
+                event.u.set_report_reply.err = 0;
+                write(&event, sizeof(event));
+                break;
+            }
+            
+            default:
+                break;
+        }
+    }
+}
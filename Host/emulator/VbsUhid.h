@@ -0,0 +1,51 @@
+/*
+    VbsUhid.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    One HID interface of the emulated button as a virtual device of the kernel (/dev/uhid).
+    The kernel's requests are handed to the owner, who answers them from the simulated board.
+*/
+
+#ifndef VBS_UHID_h
+#define VBS_UHID_h
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+class VbsUhid
+{
+private:
+    int _fd = -1;
+    
+    bool write(const void* event, const size_t size);
+    
+public:
+    // USB IDs of the Arduino Leonardo, like the real button
+    static const uint16_t VendorId = 0x2341;
+    static const uint16_t ProductId = 0x8036;
+    
+    // Handlers of the kernel's requests (get report returns false to fail the request)
+    std::function<void(bool open)> OnOpen;
+    std::function<void(uint8_t type, const std::vector<uint8_t>& data)> OnSetReport;
+    std::function<bool(uint8_t type, uint8_t id, std::vector<uint8_t>& data)> OnGetReport;
+    
+    VbsUhid();
+    ~VbsUhid();
+    VbsUhid(const VbsUhid&) = delete;
+    VbsUhid& operator=(const VbsUhid&) = delete;
+    
+    // Creates the device, returns false with errno set when /dev/uhid is not available
+    bool Create(const std::string& name, const std::string& physical, const std::string& unique, const std::vector<uint8_t>& descriptor);
+    void Destroy();
+    
+    int GetFd() const;
+    bool SendInput(const std::vector<uint8_t>& data);
+    
+    // Handles the pending requests of the kernel without blocking
+    void Process();
+};
+
+#endif
@@ -0,0 +1,231 @@
+/*
+    main.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    brb-emulator: runs the Big Red Button firmware on the PC, presses the button as the scripts
+    say, and shows up as a real HID device through /dev/uhid. See the Host section of the README.
+*/
+
+#include "VbsEmulator.h"
+#include "VbsUhid.h"
+#include <Shim.h>
+#include <chrono>
+#include <errno.h>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct Options
+{
+    std::vector<std::string> Scripts;
+    bool Uhid = false;
+    bool Realtime = false;
+    bool Dump = false;
+    int Devices = 1;
+    long Stagger = 0; // ms
+    long Linger = -1; // ms, -1: forever with uhid, otherwise 0
+    long long HostOffset = 0; // us
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onStopSignal(int)
+{
+    stopRequested = 1;
+}
+
+static void usage()
+{
+    std::cerr <<
+        "usage: brb-emulator [options] [script...]\n"
+        "  --uhid            create the HID interfaces as devices of the kernel (/dev/uhid), runs in real time\n"
+        "  --realtime        run on the wall clock (always on with --uhid)\n"
+        "  --devices N       emulate N buttons, device i runs script i % (number of scripts)\n"
+        "  --stagger MS      start device i after i * MS milliseconds\n"
+        "  --linger MS       keep running after the script (default: forever with --uhid, otherwise 0)\n"
+        "  --host-offset US  host clock minus the virtual clock, for the sync command\n"
+        "  --dump            print the input reports the host receives\n"
+        "A script of - is read from the standard input.\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--uhid") options.Uhid = true;
+        else if (arg == "--realtime") options.Realtime = true;
+        else if (arg == "--dump") options.Dump = true;
+        else if (arg == "--devices" && hasValue) options.Devices = atoi(argv[++i]);
+        else if (arg == "--stagger" && hasValue) options.Stagger = atol(argv[++i]);
+        else if (arg == "--linger" && hasValue) options.Linger = atol(argv[++i]);
+        else if (arg == "--host-offset" && hasValue) options.HostOffset = atoll(argv[++i]);
+        else if (arg == "-" || arg[0] != '-') options.Scripts.push_back(arg);
+        else return false;
+    }
+    if (options.Linger < 0) options.Linger = options.Uhid ? -1 : 0;
+    options.Realtime |= options.Uhid;
+    return options.Devices >= 1;
+}
+
+static int runDevice(const Options& options, const int index)
+{
+    VbsEmulator emulator;
+    VbsUhid devices[2];
+    const auto wallStart = std::chrono::steady_clock::now();
+    
+    Shim::SetPacketHandler([&](const Shim::Packet& packet) {
+        const int interface = packet.Endpoint == Shim::GetEndpoint(0) ? 0 : 1;
+        if (options.Dump)
+        {
+            std::string line = std::to_string(index) + " " + std::to_string(packet.Time / 1000) + "." +
+                std::to_string(packet.Time % 1000 + 1000).substr(1) + " if" + std::to_string(interface);
+            char hex[4];
+            for (const uint8_t value : packet.Data)
+            {
+                snprintf(hex, sizeof(hex), " %02x", value);
+                line += hex;
+            }
+            printf("%s\n", line.c_str());
+            fflush(stdout);
+        }
+        if (options.Uhid) devices[interface].SendInput(packet.Data);
+    });
+    
+    emulator.SetHostClockOffset(options.HostOffset);
+    emulator.SetIdleHandler([&]() {
+        if (stopRequested) exit(0);
+        if (!options.Realtime) return;
+        
+        // Sleep while the virtual clock is ahead of the wall clock, answering the kernel meanwhile
+        const long long wall = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wallStart).count();
+        const long long ahead = (long long)Shim::Now() - wall;
+        pollfd fds[2];
+        for (int i = 0; i < 2; i++) fds[i] = { devices[i].GetFd(), POLLIN, 0 };
+        if (ahead >= 1000 || options.Uhid) poll(fds, 2, ahead >= 1000 ? (int)(ahead / 1000) : 0);
+        for (int i = 0; i < 2; i++) devices[i].Process();
+    });
+    
+    emulator.Start();
+    
+    // Nobody reads the interfaces of a uhid device until they are opened
+    Shim::SetEndpointPolled(Shim::GetEndpoint(0), !options.Uhid);
+    Shim::SetEndpointPolled(Shim::GetEndpoint(1), !options.Uhid);
+    
+    if (options.Uhid)
+    {
+        const std::string unique = "brb-emulator-" + std::to_string(getpid()) + "-" + std::to_string(index);
+        for (int i = 0; i < 2; i++)
+        {
+            const uint8_t interface = Shim::GetInterface(i);
+            const uint8_t endpoint = Shim::GetEndpoint(i);
+            devices[i].OnOpen = [endpoint](bool open) { Shim::SetEndpointPolled(endpoint, open); };
+            devices[i].OnGetReport = [interface](uint8_t type, uint8_t id, std::vector<uint8_t>& data) {
+                data = Shim::GetReport(interface, type, id, 255);
+                return !data.empty();
+            };
+            devices[i].OnSetReport = [interface](uint8_t type, const std::vector<uint8_t>& data) {
+                if (!data.empty()) Shim::SetReport(interface, type, data[0], data);
+            };
+            
+            if (!devices[i].Create("VB Studio Big Red Button (emulated)", unique + "/input" + std::to_string(i), unique,
+                Shim::GetReportDescriptor(interface)))
+            {
+                std::cerr << "brb-emulator: /dev/uhid: " << strerror(errno) << "\n";
+                return 1;
+            }
+        }
+    }
+    
+    emulator.Run((uint64_t)options.Stagger * index * 1000);
+    
+    if (!options.Scripts.empty())
+    {
+        const std::string& path = options.Scripts[index % options.Scripts.size()];
+        std::ifstream file;
+        if (path != "-")
+        {
+            file.open(path);
+            if (!file)
+            {
+                std::cerr << "brb-emulator: cannot open " << path << "\n";
+                return 1;
+            }
+        }
+        
+        std::string error;
+        if (!emulator.RunScript(path == "-" ? std::cin : file, error))
+        {
+            std::cerr << "brb-emulator: " << path << ": " << error << "\n";
+            return 1;
+        }
+    }
+    
+    if (options.Linger < 0)
+    {
+        for (;;) emulator.Run(1000000);
+    }
+    emulator.Run((uint64_t)options.Linger * 1000);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 2;
+    }
+    
+    // (No SA_RESTART, waitpid() must return to pass the signal on to the devices)
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStopSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    
+    if (options.Devices == 1) return runDevice(options, 0);
+    
+    // One process per button, every one of them has its own simulated board
+    std::vector<pid_t> children;
+    for (int i = 0; i < options.Devices; i++)
+    {
+        fflush(stdout);
+        const pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("brb-emulator: fork");
+            break;
+        }
+        if (pid == 0) _exit(runDevice(options, i));
+        children.push_back(pid);
+    }
+    
+    int result = 0;
+    for (size_t waiting = children.size(); waiting > 0;)
+    {
+        int status;
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno != EINTR) break;
+            if (stopRequested)
+            {
+                for (const pid_t child : children) kill(child, SIGTERM);
+            }
+            continue;
+        }
+        waiting--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) result = 1;
+    }
+    return result;
+}
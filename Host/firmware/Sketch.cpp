@@ -0,0 +1,10 @@
+/*
+    Sketch.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Builds a sketch like the Arduino IDE does: Arduino.h first, then the .ino as is.
+*/
+
+#include <Arduino.h>
+#include SKETCH_FILE
@@ -0,0 +1,127 @@
+/*
+    PluggableUSB.h (host shim)
+    
+    The parts of the Arduino USB core the libraries use. Modules are plugged at the interfaces and
+    endpoints they would get on a Leonardo (after the CDC serial port), the control requests and the
+    host side of the endpoints are driven from Shim.h.
+*/
+
+#ifndef SHIM_PLUGGABLE_USB_h
+#define SHIM_PLUGGABLE_USB_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef struct
+{
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint8_t wValueL;
+    uint8_t wValueH;
+    uint16_t wIndex;
+    uint16_t wLength;
+} USBSetup;
+
+typedef struct
+{
+    uint8_t len;
+    uint8_t dtype;
+    uint8_t number;
+    uint8_t alternate;
+    uint8_t numEndpoints;
+    uint8_t interfaceClass;
+    uint8_t interfaceSubClass;
+    uint8_t protocol;
+    uint8_t iInterface;
+} InterfaceDescriptor;
+
+typedef struct
+{
+    uint8_t len;
+    uint8_t dtype;
+    uint8_t addr;
+    uint8_t attr;
+    uint16_t packetSize;
+    uint8_t interval;
+} __attribute__((packed)) EndpointDescriptor;
+
+#define D_INTERFACE(_n,_numEndpoints,_class,_subClass,_protocol) \
+    { 9, 4, (uint8_t)(_n), 0, (uint8_t)(_numEndpoints), (uint8_t)(_class), (uint8_t)(_subClass), (uint8_t)(_protocol), 0 }
+#define D_ENDPOINT(_addr,_attr,_packetSize,_interval) \
+    { 7, 5, (uint8_t)(_addr), (uint8_t)(_attr), (uint16_t)(_packetSize), (uint8_t)(_interval) }
+
+#define USB_ENDPOINT_IN(addr) ((uint8_t)((addr) | 0x80))
+#define USB_ENDPOINT_OUT(addr) ((uint8_t)((addr) & 0x7F))
+#define USB_ENDPOINT_TYPE_INTERRUPT 0x03
+#define USB_EP_SIZE 64
+#define USB_DEVICE_CLASS_HUMAN_INTERFACE 0x03
+
+#define EP_TYPE_INTERRUPT_IN 0xC1
+#define EP_TYPE_INTERRUPT_OUT 0xC0
+
+#define TRANSFER_PGM 0x80
+#define TRANSFER_RELEASE 0x40
+#define TRANSFER_ZERO 0x20
+
+#define REQUEST_DEVICETOHOST_STANDARD_INTERFACE 0x81
+#define REQUEST_DEVICETOHOST_CLASS_INTERFACE 0xA1
+#define REQUEST_HOSTTODEVICE_CLASS_INTERFACE 0x21
+
+int USB_SendControl(uint8_t flags, const void* data, int length);
+int USB_RecvControl(void* data, int length);
+int USB_Send(uint8_t endpoint, const void* data, int length);
+uint8_t USB_SendSpace(uint8_t endpoint);
+int USB_Recv(uint8_t endpoint, void* data, int length);
+int USB_Available(uint8_t endpoint);
+
+class PluggableUSBModule
+{
+public:
+    PluggableUSBModule(uint8_t numEps, uint8_t numIfs, uint8_t* epType) :
+        numEndpoints(numEps), numInterfaces(numIfs), endpointType(epType)
+    { }
+    virtual ~PluggableUSBModule() {}
+    
+protected:
+    virtual bool setup(USBSetup& setup) = 0;
+    virtual int getInterface(uint8_t* interfaceCount) = 0;
+    virtual int getDescriptor(USBSetup& setup) = 0;
+    virtual uint8_t getShortName(char* name) { name[0] = 'A' + pluggedInterface; return 1; }
+    
+    uint8_t pluggedInterface;
+    uint8_t pluggedEndpoint;
+    
+    const uint8_t numEndpoints;
+    const uint8_t numInterfaces;
+    const uint8_t* endpointType;
+    
+    PluggableUSBModule* next = NULL;
+    
+    friend class PluggableUSB_;
+};
+
+class PluggableUSB_
+{
+public:
+    PluggableUSB_();
+    bool plug(PluggableUSBModule* node);
+    
+    // Host side (used by Shim.cpp)
+    int getInterface(uint8_t* interfaceCount);
+    int getDescriptor(USBSetup& setup);
+    bool setup(USBSetup& setup);
+    PluggableUSBModule* rootNode() const { return _rootNode; }
+    uint8_t interfaceOf(const PluggableUSBModule* node) const { return node->pluggedInterface; }
+    uint8_t endpointOf(const PluggableUSBModule* node) const { return node->pluggedEndpoint; }
+    uint8_t endpointCountOf(const PluggableUSBModule* node) const { return node->numEndpoints; }
+    uint8_t interfaceCountOf(const PluggableUSBModule* node) const { return node->numInterfaces; }
+    
+private:
+    uint8_t _lastIf;
+    uint8_t _lastEp;
+    PluggableUSBModule* _rootNode;
+};
+
+PluggableUSB_& PluggableUSB();
+
+#endif
@@ -0,0 +1,651 @@
+/*
+    Shim.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+*/
+
+#include "Shim.h"
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stdio.h>
+
+// Registers
+volatile uint8_t SREG;
+volatile uint8_t TCCR3A;
+volatile uint8_t TCCR3B;
+volatile uint8_t TIMSK3;
+volatile uint8_t TIFR3;
+volatile uint16_t OCR3A;
+volatile uint16_t TCNT3;
+volatile uint8_t ADCSRA;
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+// Defined by the firmware (VbsKeyboard), if linked in
+extern "C" void TIMER3_COMPA_vect(void) __attribute__((weak));
+
+// Approximate time of the core functions on a 16 MHz ATmega32U4 (us)
+static const uint64_t COST_MICROS = 2;
+static const uint64_t COST_MILLIS = 1;
+static const uint64_t COST_DIGITAL_IO = 3;
+static const uint64_t COST_ANALOG_WRITE = 5;
+static const uint64_t COST_ANALOG_READ = 2; // (plus the conversion)
+static const uint64_t EEPROM_WRITE_TIME = 3400;
+
+static const int PIN_COUNT = 32;
+static const int ENDPOINT_COUNT = 8;
+static const size_t ENDPOINT_BANKS = 2;
+static const uint16_t SEND_TIMEOUT = 250; // ms, like USB_Send() in the core
+
+struct EndpointState
+{
+    std::vector<uint8_t> bank;
+    std::deque<std::vector<uint8_t> > released;
+    bool polled;
+};
+
+static struct
+{
+    uint64_t now;
+    uint64_t nextFrame;
+    uint64_t nextTimer;
+    bool timerPending;
+    bool inInterrupt;
+    
+    int analog[PIN_COUNT];
+    int digital[PIN_COUNT];
+    int pwm[PIN_COUNT];
+    std::function<int(uint8_t, uint64_t)> analogSource;
+    
+    EndpointState endpoints[ENDPOINT_COUNT];
+    std::function<void(const Shim::Packet&)> packetHandler;
+    bool configured;
+    
+    std::vector<uint8_t>* controlCapture;
+    const uint8_t* controlData;
+    size_t controlLength;
+    size_t controlPosition;
+    
+    uint8_t eeprom[E2END + 1];
+    uint64_t eepromBusyUntil;
+    
+    std::deque<uint8_t> serialOutput[2];
+    std::deque<uint8_t> serialInput[2];
+    
+    Shim::Counters counters;
+} _state;
+
+
+//
+// Clock, interrupts and frames
+//
+static uint64_t TimerPeriod()
+{
+    // Only CTC mode with the compare interrupt is simulated, that is all the libraries use
+    static const uint16_t prescalers[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    const uint16_t prescaler = prescalers[TCCR3B & 0x07];
+    if (!(TIMSK3 & (1 << OCIE3A)) || !(TCCR3B & (1 << WGM32)) || prescaler == 0) return 0;
+    return ((uint64_t)OCR3A + 1) * prescaler * 1000000 / F_CPU;
+}
+
+static void RunTimerInterrupt()
+{
+    if (!(SREG & 0x80) || _state.inInterrupt || !TIMER3_COMPA_vect)
+    {
+        _state.timerPending = TIMER3_COMPA_vect != NULL;
+        return;
+    }
+    
+    _state.timerPending = false;
+    _state.inInterrupt = true;
+    const uint8_t oldSREG = SREG;
+    cli();
+    _state.counters.TimerInterrupts++;
+    TIMER3_COMPA_vect();
+    SREG = oldSREG;
+    _state.inInterrupt = false;
+}
+
+static void RunFrame()
+{
+    for (int i = 0; i < ENDPOINT_COUNT; i++)
+    {
+        EndpointState& endpoint = _state.endpoints[i];
+        if (!endpoint.polled || endpoint.released.empty()) continue;
+        
+        Shim::Packet packet;
+        packet.Endpoint = i;
+        packet.Time = _state.now;
+        packet.Data.swap(endpoint.released.front());
+        endpoint.released.pop_front();
+        _state.counters.UsbPackets++;
+        if (_state.packetHandler) _state.packetHandler(packet);
+    }
+}
+
+void Shim::Advance(uint64_t us)
+{
+    const uint64_t target = _state.now + us;
+    while (true)
+    {
+        // (The firmware may have started or stopped the timer since the last step)
+        const uint64_t period = TimerPeriod();
+        if (period == 0) _state.nextTimer = 0;
+        else if (_state.nextTimer == 0) _state.nextTimer = _state.now + period;
+        
+        if (_state.timerPending && period != 0) RunTimerInterrupt();
+        
+        uint64_t next = target;
+        if (_state.nextFrame < next) next = _state.nextFrame;
+        if (_state.nextTimer != 0 && _state.nextTimer < next) next = _state.nextTimer;
+        _state.now = next;
+        
+        if (_state.now == _state.nextFrame)
+        {
+            _state.nextFrame += 1000;
+            RunFrame();
+        }
+        if (_state.nextTimer != 0 && _state.now == _state.nextTimer)
+        {
+            _state.nextTimer += period;
+            RunTimerInterrupt();
+        }
+        if (_state.now >= target) break;
+    }
+}
+
+uint64_t Shim::Now()
+{
+    return _state.now;
+}
+
+void Shim::Reset(uint64_t startTime)
+{
+    _state.now = startTime;
+    _state.nextFrame = (startTime / 1000 + 1) * 1000;
+    _state.nextTimer = 0;
+    _state.timerPending = false;
+    _state.inInterrupt = false;
+    
+    for (int i = 0; i < PIN_COUNT; i++)
+    {
+        _state.analog[i] = 1023;
+        _state.digital[i] = HIGH;
+        _state.pwm[i] = 0;
+    }
+    _state.analogSource = nullptr;
+    
+    for (int i = 0; i < ENDPOINT_COUNT; i++)
+    {
+        _state.endpoints[i].bank.clear();
+        _state.endpoints[i].released.clear();
+        _state.endpoints[i].polled = true;
+    }
+    _state.configured = true;
+    _state.controlCapture = NULL;
+    
+    memset(_state.eeprom, 0xFF, sizeof(_state.eeprom));
+    _state.eepromBusyUntil = 0;
+    
+    for (int i = 0; i < 2; i++)
+    {
+        _state.serialOutput[i].clear();
+        _state.serialInput[i].clear();
+    }
+    memset(&_state.counters, 0, sizeof(_state.counters));
+    
+    // As init() of the core leaves them
+    SREG = 0x80;
+    TCCR3A = (1 << WGM30);
+    TCCR3B = (1 << CS31) | (1 << CS30);
+    TIMSK3 = 0;
+    TIFR3 = 0;
+    OCR3A = 0;
+    TCNT3 = 0;
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+Shim::Counters& Shim::GetCounters()
+{
+    return _state.counters;
+}
+
+
+//
+// Core functions
+//
+unsigned long micros(void)
+{
+    Shim::Advance(COST_MICROS);
+    return (unsigned long)(uint32_t)_state.now;
+}
+
+unsigned long millis(void)
+{
+    Shim::Advance(COST_MILLIS);
+    return (unsigned long)(uint32_t)(_state.now / 1000);
+}
+
+void delay(unsigned long ms)
+{
+    Shim::Advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    Shim::Advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    Shim::Advance(COST_DIGITAL_IO);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    Shim::Advance(COST_DIGITAL_IO);
+    if (pin < PIN_COUNT) _state.pwm[pin] = val ? 255 : 0;
+}
+
+int digitalRead(uint8_t pin)
+{
+    Shim::Advance(COST_DIGITAL_IO);
+    _state.counters.DigitalReads++;
+    return pin < PIN_COUNT ? _state.digital[pin] : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+    // The sample is taken at the start, the conversion takes 13 ADC clocks
+    static const uint8_t dividers[8] = { 2, 2, 4, 8, 16, 32, 64, 128 };
+    int value = pin < PIN_COUNT ? _state.analog[pin] : 0;
+    if (_state.analogSource) value = _state.analogSource(pin, _state.now);
+    
+    const uint64_t conversion = 13ULL * dividers[ADCSRA & 0x07] * 1000000 / F_CPU;
+    _state.counters.AnalogReads++;
+    _state.counters.AdcTime += conversion;
+    Shim::Advance(COST_ANALOG_READ + conversion);
+    return value < 0 ? 0 : (value > 1023 ? 1023 : value);
+}
+
+void analogWrite(uint8_t pin, int val)
+{
+    Shim::Advance(COST_ANALOG_WRITE);
+    _state.counters.AnalogWrites++;
+    if (pin < PIN_COUNT) _state.pwm[pin] = val;
+}
+
+void Shim::SetAnalog(uint8_t pin, int value)
+{
+    if (pin < PIN_COUNT) _state.analog[pin] = value;
+}
+
+void Shim::SetAnalogSource(std::function<int(uint8_t pin, uint64_t now)> source)
+{
+    _state.analogSource = source;
+}
+
+void Shim::SetDigital(uint8_t pin, int value)
+{
+    if (pin < PIN_COUNT) _state.digital[pin] = value;
+}
+
+int Shim::GetPwm(uint8_t pin)
+{
+    return pin < PIN_COUNT ? _state.pwm[pin] : 0;
+}
+
+
+//
+// EEPROM and CRC
+//
+void eeprom_read_block(void* dst, const void* src, size_t n)
+{
+    const size_t address = (size_t)src;
+    for (size_t i = 0; i < n; i++)
+    {
+        ((uint8_t*)dst)[i] = address + i <= E2END ? _state.eeprom[address + i] : 0xFF;
+    }
+}
+
+uint8_t eeprom_read_byte(const uint8_t* address)
+{
+    return (size_t)address <= E2END ? _state.eeprom[(size_t)address] : 0xFF;
+}
+
+int eeprom_is_ready(void)
+{
+    return _state.now >= _state.eepromBusyUntil;
+}
+
+void eeprom_update_byte(uint8_t* address, uint8_t value)
+{
+    // Waits for the previous write, like avr-libc
+    if (!eeprom_is_ready()) Shim::Advance(_state.eepromBusyUntil - _state.now);
+    if ((size_t)address > E2END || _state.eeprom[(size_t)address] == value) return;
+    _state.eeprom[(size_t)address] = value;
+    _state.eepromBusyUntil = _state.now + EEPROM_WRITE_TIME;
+}
+
+void eeprom_update_block(const void* src, void* dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        eeprom_update_byte((uint8_t*)dst + i, ((const uint8_t*)src)[i]);
+    }
+}
+
+uint16_t _crc16_update(uint16_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (int i = 0; i < 8; i++)
+    {
+        crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+    }
+    return crc;
+}
+
+uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (int i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+
+//
+// Serial
+//
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+    {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::print(long value)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%ld", value);
+    return write(text);
+}
+
+static int SerialPort(const HardwareSerial* serial)
+{
+    return serial == &Serial1 ? 1 : 0;
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+}
+
+int HardwareSerial::available()
+{
+    return (int)_state.serialInput[SerialPort(this)].size();
+}
+
+int HardwareSerial::read()
+{
+    std::deque<uint8_t>& input = _state.serialInput[SerialPort(this)];
+    if (input.empty()) return -1;
+    const uint8_t value = input.front();
+    input.pop_front();
+    return value;
+}
+
+int HardwareSerial::peek()
+{
+    std::deque<uint8_t>& input = _state.serialInput[SerialPort(this)];
+    return input.empty() ? -1 : input.front();
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    _state.serialOutput[SerialPort(this)].push_back(value);
+    return 1;
+}
+
+int HardwareSerial::availableForWrite()
+{
+    return 63;
+}
+
+std::deque<uint8_t>& Shim::SerialOutput(int port)
+{
+    return _state.serialOutput[port ? 1 : 0];
+}
+
+std::deque<uint8_t>& Shim::SerialInput(int port)
+{
+    return _state.serialInput[port ? 1 : 0];
+}
+
+
+//
+// USB device side
+//
+static void ReleaseBank(EndpointState& endpoint)
+{
+    endpoint.released.push_back(endpoint.bank);
+    endpoint.bank.clear();
+}
+
+uint8_t USB_SendSpace(uint8_t ep)
+{
+    const EndpointState& endpoint = _state.endpoints[ep & 0x07];
+    if (!_state.configured || endpoint.released.size() >= ENDPOINT_BANKS) return 0;
+    return USB_EP_SIZE - endpoint.bank.size();
+}
+
+int USB_Send(uint8_t ep, const void* data, int length)
+{
+    if (!_state.configured) return -1;
+    
+    EndpointState& endpoint = _state.endpoints[ep & 0x07];
+    const uint8_t* bytes = (const uint8_t*)data;
+    const int total = length;
+    uint16_t timeout = SEND_TIMEOUT;
+    while (length > 0)
+    {
+        int n = USB_SendSpace(ep);
+        if (n == 0)
+        {
+            if (!(--timeout)) return -1;
+            _state.counters.UsbWaits++;
+            delay(1);
+            continue;
+        }
+        if (n > length) n = length;
+        
+        endpoint.bank.insert(endpoint.bank.end(), bytes, bytes + n);
+        bytes += n;
+        length -= n;
+        if (endpoint.bank.size() >= USB_EP_SIZE) ReleaseBank(endpoint);
+    }
+    if ((ep & TRANSFER_RELEASE) && !endpoint.bank.empty()) ReleaseBank(endpoint);
+    return total;
+}
+
+int USB_Recv(uint8_t ep, void* data, int length)
+{
+    return 0;
+}
+
+int USB_Available(uint8_t ep)
+{
+    return 0;
+}
+
+int USB_SendControl(uint8_t flags, const void* data, int length)
+{
+    if (_state.controlCapture)
+    {
+        _state.controlCapture->insert(_state.controlCapture->end(), (const uint8_t*)data, (const uint8_t*)data + length);
+    }
+    return length;
+}
+
+int USB_RecvControl(void* data, int length)
+{
+    const size_t n = (size_t)length < _state.controlLength - _state.controlPosition
+        ? (size_t)length : _state.controlLength - _state.controlPosition;
+    memcpy(data, _state.controlData + _state.controlPosition, n);
+    _state.controlPosition += n;
+    return (int)n;
+}
+
+PluggableUSB_::PluggableUSB_() :
+    _lastIf(2), // (CDC serial has interfaces 0-1 and endpoints 1-3)
+    _lastEp(4),
+    _rootNode(NULL)
+{
+}
+
+bool PluggableUSB_::plug(PluggableUSBModule* node)
+{
+    if (_lastEp + node->numEndpoints > ENDPOINT_COUNT) return false;
+    
+    if (!_rootNode)
+    {
+        _rootNode = node;
+    }
+    else
+    {
+        PluggableUSBModule* current = _rootNode;
+        while (current->next) current = current->next;
+        current->next = node;
+    }
+    
+    node->pluggedInterface = _lastIf;
+    node->pluggedEndpoint = _lastEp;
+    _lastIf += node->numInterfaces;
+    _lastEp += node->numEndpoints;
+    return true;
+}
+
+int PluggableUSB_::getInterface(uint8_t* interfaceCount)
+{
+    int sent = 0;
+    for (PluggableUSBModule* node = _rootNode; node; node = node->next)
+    {
+        const int res = node->getInterface(interfaceCount);
+        if (res < 0) return -1;
+        sent += res;
+    }
+    return sent;
+}
+
+int PluggableUSB_::getDescriptor(USBSetup& setup)
+{
+    for (PluggableUSBModule* node = _rootNode; node; node = node->next)
+    {
+        const int ret = node->getDescriptor(setup);
+        if (ret != 0) return ret;
+    }
+    return 0;
+}
+
+bool PluggableUSB_::setup(USBSetup& setup)
+{
+    for (PluggableUSBModule* node = _rootNode; node; node = node->next)
+    {
+        if (node->setup(setup)) return true;
+    }
+    return false;
+}
+
+PluggableUSB_& PluggableUSB()
+{
+    static PluggableUSB_ obj;
+    return obj;
+}
+
+
+//
+// USB host side
+//
+void Shim::SetPacketHandler(std::function<void(const Packet& packet)> handler)
+{
+    _state.packetHandler = handler;
+}
+
+void Shim::SetEndpointPolled(uint8_t endpoint, bool polled)
+{
+    _state.endpoints[endpoint & 0x07].polled = polled;
+}
+
+void Shim::SetConfigured(bool configured)
+{
+    _state.configured = configured;
+}
+
+uint8_t Shim::GetInterface(uint8_t index)
+{
+    PluggableUSBModule* node = PluggableUSB().rootNode();
+    return node ? PluggableUSB().interfaceOf(node) + index : 0;
+}
+
+uint8_t Shim::GetEndpoint(uint8_t index)
+{
+    PluggableUSBModule* node = PluggableUSB().rootNode();
+    return node ? PluggableUSB().endpointOf(node) + index : 0;
+}
+
+// Control requests arrive in the USB interrupt
+template <typename Function>
+static void RunControl(std::vector<uint8_t>* capture, const std::vector<uint8_t>* data, Function function)
+{
+    const uint8_t oldSREG = SREG;
+    cli();
+    const bool wasInInterrupt = _state.inInterrupt;
+    _state.inInterrupt = true;
+    _state.controlCapture = capture;
+    _state.controlData = data ? data->data() : NULL;
+    _state.controlLength = data ? data->size() : 0;
+    _state.controlPosition = 0;
+    function();
+    _state.controlCapture = NULL;
+    _state.inInterrupt = wasInInterrupt;
+    SREG = oldSREG;
+}
+
+std::vector<uint8_t> Shim::GetConfiguration()
+{
+    std::vector<uint8_t> result;
+    uint8_t interfaceCount = 0;
+    RunControl(&result, NULL, [&]() { PluggableUSB().getInterface(&interfaceCount); });
+    return result;
+}
+
+std::vector<uint8_t> Shim::GetReportDescriptor(uint8_t interface)
+{
+    USBSetup setup = { REQUEST_DEVICETOHOST_STANDARD_INTERFACE, 0x06, 0, 0x22, interface, 0xFFFF };
+    std::vector<uint8_t> result;
+    RunControl(&result, NULL, [&]() { PluggableUSB().getDescriptor(setup); });
+    return result;
+}
+
+std::vector<uint8_t> Shim::GetReport(uint8_t interface, uint8_t type, uint8_t id, uint16_t length)
+{
+    USBSetup setup = { REQUEST_DEVICETOHOST_CLASS_INTERFACE, 0x01, id, type, interface, length };
+    std::vector<uint8_t> result;
+    RunControl(&result, NULL, [&]() { PluggableUSB().setup(setup); });
+    if (result.size() > length) result.resize(length);
+    return result;
+}
+
+bool Shim::SetReport(uint8_t interface, uint8_t type, uint8_t id, const std::vector<uint8_t>& data)
+{
+    USBSetup setup = { REQUEST_HOSTTODEVICE_CLASS_INTERFACE, 0x09, id, type, interface, (uint16_t)data.size() };
+    bool handled = false;
+    RunControl(NULL, &data, [&]() { handled = PluggableUSB().setup(setup); });
+    return handled;
+}
@@ -0,0 +1,79 @@
+/*
+    Shim.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Host side of the simulated board: the virtual clock, the pins, and the USB host polling the
+    endpoints and sending control requests. Everything runs on one thread, the Timer3 interrupt
+    and the USB frames happen whenever the firmware lets time pass (analogRead(), micros(),
+    delay(), waiting for an endpoint) or the host calls Advance().
+*/
+
+#ifndef SHIM_h
+#define SHIM_h
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace Shim
+{
+    // Input report as the host receives it (one packet of an interrupt IN endpoint)
+    struct Packet
+    {
+        uint8_t Endpoint;
+        uint64_t Time; // us
+        std::vector<uint8_t> Data;
+    };
+    
+    // Rough cost of the firmware, for the benchmark
+    struct Counters
+    {
+        unsigned long AnalogReads;
+        unsigned long AnalogWrites;
+        unsigned long DigitalReads;
+        unsigned long UsbPackets;
+        unsigned long UsbWaits; // ms spent waiting for an endpoint in USB_Send()
+        unsigned long TimerInterrupts;
+        uint64_t AdcTime; // us
+    };
+    
+    // Start over: clock at startTime (us), pins idle, endpoints empty, EEPROM erased
+    void Reset(uint64_t startTime = 0);
+    
+    // Virtual clock (us), micros() is the low 32 bits of it
+    uint64_t Now();
+    void Advance(uint64_t us);
+    
+    // Pins (analog value of a pin, or a function for changing signals)
+    void SetAnalog(uint8_t pin, int value);
+    void SetAnalogSource(std::function<int(uint8_t pin, uint64_t now)> source);
+    void SetDigital(uint8_t pin, int value);
+    int GetPwm(uint8_t pin);
+    
+    // USB host: packets are handed over as the host polls the endpoints (once per frame, 1 ms).
+    // A host that does not poll an endpoint (nobody opened that interface) leaves its packets in
+    // the two banks of the endpoint, and USB_Send() waits up to 250 ms for room like the real core.
+    void SetPacketHandler(std::function<void(const Packet& packet)> handler);
+    void SetEndpointPolled(uint8_t endpoint, bool polled);
+    void SetConfigured(bool configured);
+    
+    // Interfaces and endpoints of the plugged module (index 0 is the first one of the module)
+    uint8_t GetInterface(uint8_t index);
+    uint8_t GetEndpoint(uint8_t index);
+    
+    // Control requests, run as if in the USB interrupt
+    std::vector<uint8_t> GetConfiguration();
+    std::vector<uint8_t> GetReportDescriptor(uint8_t interface);
+    std::vector<uint8_t> GetReport(uint8_t interface, uint8_t type, uint8_t id, uint16_t length);
+    bool SetReport(uint8_t interface, uint8_t type, uint8_t id, const std::vector<uint8_t>& data);
+    
+    // Serial ports: bytes the sketch wrote, and bytes for the sketch to read
+    std::deque<uint8_t>& SerialOutput(int port);
+    std::deque<uint8_t>& SerialInput(int port);
+    
+    Counters& GetCounters();
+}
+
+#endif
@@ -0,0 +1,21 @@
+/*
+    avr/eeprom.h (host shim)
+    
+    1 KB of EEPROM in memory, erased (0xFF) at start.
+*/
+
+#ifndef SHIM_EEPROM_h
+#define SHIM_EEPROM_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END 0x3FF
+
+void eeprom_read_block(void* dst, const void* src, size_t n);
+void eeprom_update_block(const void* src, void* dst, size_t n);
+uint8_t eeprom_read_byte(const uint8_t* address);
+void eeprom_update_byte(uint8_t* address, uint8_t value);
+int eeprom_is_ready(void);
+
+#endif
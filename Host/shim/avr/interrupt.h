@@ -0,0 +1,19 @@
+/*
+    avr/interrupt.h (host shim)
+    
+    Interrupt handlers are plain functions, Shim.cpp calls them between two simulated steps
+    while the I bit of SREG is set.
+*/
+
+#ifndef SHIM_INTERRUPT_h
+#define SHIM_INTERRUPT_h
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+#define cli() (SREG &= (uint8_t)~0x80)
+#define sei() (SREG |= 0x80)
+#define ISR(vector) extern "C" void vector(void)
+
+#endif
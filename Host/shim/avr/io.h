@@ -0,0 +1,38 @@
+/*
+    avr/io.h (host shim)
+    
+    ATmega32U4 registers used by the libraries, as plain variables.
+*/
+
+#ifndef SHIM_IO_h
+#define SHIM_IO_h
+
+#include <stdint.h>
+
+// Timer3
+extern volatile uint8_t TCCR3A;
+extern volatile uint8_t TCCR3B;
+extern volatile uint8_t TIMSK3;
+extern volatile uint8_t TIFR3;
+extern volatile uint16_t OCR3A;
+extern volatile uint16_t TCNT3;
+
+#define WGM30 0
+#define WGM31 1
+#define WGM32 3
+#define WGM33 4
+#define CS30 0
+#define CS31 1
+#define CS32 2
+#define OCIE3A 1
+#define OCF3A 1
+
+// ADC
+extern volatile uint8_t ADCSRA;
+
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADEN 7
+
+#endif
@@ -0,0 +1,15 @@
+/*
+    util/crc16.h (host shim)
+    
+    Same results as the avr-libc versions.
+*/
+
+#ifndef SHIM_CRC16_h
+#define SHIM_CRC16_h
+
+#include <stdint.h>
+
+uint16_t _crc16_update(uint16_t crc, uint8_t data);
+uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data);
+
+#endif
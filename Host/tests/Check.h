@@ -0,0 +1,28 @@
+/*
+    Check.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Just enough of a test framework: CHECK() reports the failed condition and the test carries on,
+    the exit code tells ctest the result (77 means skipped).
+*/
+
+#ifndef CHECK_h
+#define CHECK_h
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        checkFailures++; \
+    } \
+} while (0)
+
+#define CHECK_RESULT() (checkFailures == 0 ? 0 : 1)
+
+#define TEST_SKIPPED 77
+
+#endif
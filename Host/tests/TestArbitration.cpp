@@ -0,0 +1,189 @@
+/*
+    TestArbitration.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    First-press arbitration between simulated buttons: every one of them runs the clock sync
+    estimator of the firmware on its own clock (random offset, up to +-150 ppm skew, 4 us
+    resolution like micros()), the host syncs them every second with jittery control transfers,
+    and the press reports arrive with USB polling delays. The timestamps have to order presses
+    1 ms apart correctly, which the arrival order does not.
+*/
+
+#include "Check.h"
+#include <VbsArbiter.h>
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <VbsKeyboard.h>
+
+static std::mt19937 randomEngine(12345);
+
+static double uniform(const double low, const double high)
+{
+    return std::uniform_real_distribution<double>(low, high)(randomEngine);
+}
+
+struct Button
+{
+    std::string Name;
+    double Offset; // us
+    double Skew;   // ppm
+    VbsClockSync Sync;
+    
+    uint32_t Local(const double hostTime) const
+    {
+        // micros() counts in 4 us steps on a 16 MHz board
+        return (uint32_t)(int64_t)(Offset + hostTime * (1.0 + Skew * 1e-6)) & ~3u;
+    }
+};
+
+// Host writes its time, the device takes micros() when the transfer arrives
+static void sync(Button& button, const double hostTime, const double jitter)
+{
+    const double arrival = hostTime + 150.0 + uniform(0.0, jitter);
+    button.Sync.Update((uint32_t)(uint64_t)hostTime, button.Local(arrival));
+}
+
+static void testArbitration(const double start, const double jitter, const int buttonCount)
+{
+    std::vector<Button> buttons(buttonCount);
+    for (int i = 0; i < buttonCount; i++)
+    {
+        buttons[i].Name = "button-" + std::to_string(i);
+        buttons[i].Offset = uniform(0.0, 4294967296.0);
+        buttons[i].Skew = uniform(-150.0, 150.0);
+    }
+    
+    // A minute of syncs to settle the drift
+    double now = start;
+    for (int second = 0; second < 60; second++, now += 1000000.0)
+    {
+        for (Button& button : buttons) sync(button, now, jitter);
+    }
+    
+    VbsArbiter arbiter(20000);
+    double maxError = 0.0;
+    int rounds = 0;
+    int correct = 0;
+    int arrivalOrderCorrect = 0;
+    for (int round = 0; round < 200; round++)
+    {
+        // Syncs keep coming between the rounds
+        now += 1000000.0;
+        for (Button& button : buttons) sync(button, now, jitter);
+        
+        // Presses 1 ms apart in random order, each button reports 1-5 ms later
+        const double pressStart = now + uniform(0.0, 900000.0);
+        std::vector<int> order(buttonCount);
+        for (int i = 0; i < buttonCount; i++) order[i] = i;
+        std::shuffle(order.begin(), order.end(), randomEngine);
+        
+        std::vector<std::pair<double, int>> arrivals;
+        for (int rank = 0; rank < buttonCount; rank++)
+        {
+            Button& button = buttons[order[rank]];
+            const double pressTime = pressStart + rank * 1000.0;
+            const uint32_t timestamp = button.Sync.HostTime(button.Local(pressTime));
+            
+            // (The estimate carries the constant part of the transfer delay, the same for all buttons)
+            const double error = (double)(int32_t)(timestamp - (uint32_t)(uint64_t)pressTime) + 150.0 + jitter / 2;
+            if (fabs(error) > maxError) maxError = fabs(error);
+            
+            const double arrival = pressTime + uniform(1000.0, 5000.0);
+            arrivals.push_back({ arrival, order[rank] });
+            arbiter.AddPress(button.Name, (uint64_t)arrival);
+            arbiter.AddPressTime(button.Name, timestamp, (uint64_t)arrival);
+        }
+        
+        std::sort(arrivals.begin(), arrivals.end());
+        if (arrivals[0].second == order[0]) arrivalOrderCorrect++;
+        
+        std::vector<VbsPress> ranking;
+        CHECK(!arbiter.Poll((uint64_t)(pressStart + 5000.0), ranking));
+        CHECK(arbiter.Poll((uint64_t)(pressStart + buttonCount * 1000.0 + 30000.0), ranking));
+        rounds++;
+        
+        bool ordered = ranking.size() == (size_t)buttonCount;
+        for (int rank = 0; ordered && rank < buttonCount; rank++)
+        {
+            ordered = ranking[rank].Device == buttons[order[rank]].Name && ranking[rank].Timestamped;
+        }
+        if (ordered) correct++;
+    }
+    
+    printf("start %.0f s, jitter %.0f us, %d buttons: max error %.0f us, %d/%d rounds ordered, arrival order right %d times\n",
+        start / 1e6, jitter, buttonCount, maxError, correct, rounds, arrivalOrderCorrect);
+    CHECK(maxError < 400.0);
+    CHECK(correct == rounds);
+    CHECK(arrivalOrderCorrect < rounds);
+}
+
+static void testFallback()
+{
+    // Without timestamps the arrival order decides, a timestamp replaces the arrival time of the press
+    VbsArbiter arbiter(20000);
+    std::vector<VbsPress> ranking;
+    arbiter.AddPress("a", 1000000);
+    arbiter.AddPress("b", 1000500);
+    arbiter.AddPressTime("b", 999000, 1002000);
+    CHECK(arbiter.Poll(1020000, ranking));
+    CHECK(ranking.size() == 2 && ranking[0].Device == "b" && ranking[0].Timestamped && ranking[1].Device == "a" && !ranking[1].Timestamped);
+    
+    // The next round "b" lost the sync and sends no timestamp: its press still counts, by its arrival
+    arbiter.AddPress("a", 2000000);
+    arbiter.AddPressTime("a", 2000400, 2001000);
+    arbiter.AddPress("b", 2000200);
+    CHECK(arbiter.GetDeadline() == 2020000);
+    CHECK(!arbiter.Poll(2019999, ranking));
+    CHECK(arbiter.Poll(2020000, ranking));
+    CHECK(ranking.size() == 2 && ranking[0].Device == "b" && !ranking[0].Timestamped && ranking[1].Device == "a" && ranking[1].Timestamped);
+    
+    // Alone it starts a round of its own, and is synchronized again in the one after
+    arbiter.AddPress("b", 3000000);
+    CHECK(arbiter.GetDeadline() == 3020000);
+    CHECK(arbiter.Poll(3020000, ranking));
+    CHECK(ranking.size() == 1 && ranking[0].Device == "b" && !ranking[0].Timestamped && ranking[0].Time == 3000000);
+    arbiter.AddPress("b", 4000000);
+    arbiter.AddPressTime("b", 3999000, 4001000);
+    CHECK(arbiter.Poll(4020000, ranking));
+    CHECK(ranking.size() == 1 && ranking[0].Timestamped && ranking[0].Time == 3999000);
+    
+    // Timestamps across the 32-bit wrap of the host clock
+    CHECK(VbsArbiter::Unwrap(0xFFFFFF00u, 0x100000010ULL) == 0xFFFFFF00ULL);
+    CHECK(VbsArbiter::Unwrap(0x00000010u, 0x0FFFFFF00ULL) == 0x100000010ULL);
+}
+
+static void testSyncAge()
+{
+    // The estimate follows the drift between syncs, and is dropped once too old (before the 32-bit math breaks)
+    Button button;
+    button.Offset = 4294000000.0;
+    button.Skew = 80.0;
+    double now = 0.0;
+    for (int second = 0; second < 120; second++, now += 1000000.0) sync(button, now, 0.0);
+    
+    const double later = now + 540e6;
+    CHECK(button.Sync.IsValid(button.Local(later)));
+    const double error = (double)(int32_t)(button.Sync.HostTime(button.Local(later)) - (uint32_t)(uint64_t)later) + 150.0;
+    printf("9 minutes after the last sync: error %.0f us, drift %.1f ppm\n", error, button.Sync.GetDrift() * 1e6);
+    CHECK(fabs(error) < 2000.0);
+    
+    CHECK(!button.Sync.IsValid(button.Local(now + 40 * 60e6)));
+    
+    // And starts over with the next sync
+    sync(button, now + 40 * 60e6, 0.0);
+    CHECK(button.Sync.IsValid(button.Local(now + 40 * 60e6 + 1000.0)));
+}
+
+int main()
+{
+    testArbitration(10e6, 200.0, 8);
+    testArbitration(4294967296.0 - 30e6, 500.0, 16);
+    testFallback();
+    testSyncAge();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,146 @@
+/*
+    TestBusMaster.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    The BusMaster example on the shim, with satellites writing their frames into Serial1: a burst of
+    more events than the vendor report queue holds has to reach the host complete and in order, one
+    report per USB frame, also when the host only starts reading the vendor interface later.
+*/
+
+#include "Check.h"
+#include <Shim.h>
+#include <stdio.h>
+#include <vector>
+#include <VbsKeyboard.h>
+#include <VbsButtonBus.h>
+
+// Entry points and the bus of the sketch
+void setup();
+void loop();
+extern VbsButtonBus Bus;
+
+#define SATELLITES 3
+#define EVENTS_PER_SATELLITE 5
+
+// Satellite end of the bus: frames go straight into the serial input of the master
+class SatellitePort : public Stream
+{
+public:
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+
+    size_t write(uint8_t value)
+    {
+        Shim::SerialInput(1).push_back(value);
+        return 1;
+    }
+    using Print::write;
+};
+
+struct BusReport
+{
+    uint8_t Satellite;
+    uint8_t Type;
+    unsigned long Timestamp;
+};
+
+static std::vector<BusReport> reports;
+
+static void run(std::vector<VbsButtonBus*>& satellites, const uint64_t us)
+{
+    const uint64_t end = Shim::Now() + us;
+    while (Shim::Now() < end)
+    {
+        for (auto satellite : satellites) satellite->Update();
+        loop();
+        Shim::Advance(50);
+    }
+}
+
+// Every satellite sends its events 1 ms apart, the satellites interleaved
+static void burst(std::vector<VbsButtonBus*>& satellites)
+{
+    for (int i = 0; i < EVENTS_PER_SATELLITE; i++)
+    {
+        for (int s = 0; s < SATELLITES; s++)
+        {
+            satellites[s]->SendEvent(BUS_EVENT_PRESS + (i + s) % 6);
+        }
+        run(satellites, 1000);
+    }
+}
+
+static bool inOrder()
+{
+    for (size_t i = 1; i < reports.size(); i++)
+    {
+        if ((long)(reports[i].Timestamp - reports[i - 1].Timestamp) < 0) return false;
+    }
+    return true;
+}
+
+int main()
+{
+    Shim::Reset(1000000);
+    Shim::SetPacketHandler([](const Shim::Packet& packet)
+    {
+        if (packet.Endpoint == Shim::GetEndpoint(1) && packet.Data.size() == 9 &&
+            packet.Data[0] == HID_REPORTID_VENDOR && packet.Data[1] == VENDOR_BUS_EVENT)
+        {
+            const unsigned long timestamp = packet.Data[4] | (unsigned long)packet.Data[5] << 8 |
+                (unsigned long)packet.Data[6] << 16 | (unsigned long)packet.Data[7] << 24;
+            reports.push_back({ packet.Data[2], packet.Data[3], timestamp });
+        }
+    });
+    setup();
+
+    SatellitePort port;
+    std::vector<VbsButtonBus*> satellites;
+    for (int s = 1; s <= SATELLITES; s++)
+    {
+        satellites.push_back(new VbsButtonBus(port, s));
+    }
+    run(satellites, 300000);
+
+    // More events at once than the vendor queue holds, the host reading every frame
+    const int count = SATELLITES * EVENTS_PER_SATELLITE;
+    static_assert(SATELLITES * EVENTS_PER_SATELLITE > VENDOR_QUEUE_SIZE + 2, "The burst must not fit in the queue and the endpoint");
+    static_assert(SATELLITES * EVENTS_PER_SATELLITE <= BUS_QUEUE_SIZE, "The burst must fit in the bus queue");
+    burst(satellites);
+    run(satellites, 100000);
+    printf("burst: %d/%d events\n", (int)reports.size(), count);
+    CHECK((int)reports.size() == count);
+    CHECK(inOrder());
+    int perSatellite[SATELLITES] = {};
+    for (const BusReport& report : reports)
+    {
+        if (report.Satellite >= 1 && report.Satellite <= SATELLITES) perSatellite[report.Satellite - 1]++;
+    }
+    for (int s = 0; s < SATELLITES; s++)
+    {
+        CHECK(perSatellite[s] == EVENTS_PER_SATELLITE);
+    }
+
+    // The host opens the vendor interface only after the burst: the events wait on the master
+    reports.clear();
+    Shim::SetEndpointPolled(Shim::GetEndpoint(1), false);
+    burst(satellites);
+    const uint64_t start = Shim::Now();
+    run(satellites, 100000);
+    CHECK(Shim::Now() - start < 101000); // (the loop never waited for the endpoint)
+    CHECK(reports.empty());
+    Shim::SetEndpointPolled(Shim::GetEndpoint(1), true);
+    run(satellites, 100000);
+    printf("late host: %d/%d events\n", (int)reports.size(), count);
+    CHECK((int)reports.size() == count);
+    CHECK(inOrder());
+    CHECK(Bus.GetLostFrames() == 0);
+
+    for (auto satellite : satellites)
+    {
+        delete satellite;
+    }
+    return CHECK_RESULT();
+}
@@ -0,0 +1,298 @@
+/*
+    TestButtonBus.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    The serial bus with a full chain of virtual satellites: every link carries one byte per 40 us
+    (250000 baud) and can drop or corrupt bytes, satellites forward the frames of the ones further
+    down the chain, and the master has to put the events of all of them in order. The receiver has
+    to find frames again after noise or a stray sync byte without losing the frame that follows.
+*/
+
+#include "Check.h"
+#include <deque>
+#include <random>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+#include <Shim.h>
+#include <VbsButtonBus.h>
+
+#define BYTE_TIME 40 // us
+
+static std::mt19937 randomEngine(4321);
+
+static bool chance(const double probability)
+{
+    return std::uniform_real_distribution<double>(0.0, 1.0)(randomEngine) < probability;
+}
+
+// One direction of a serial line, bytes become readable once they are through the wire
+struct Link
+{
+    std::deque<std::pair<uint64_t, uint8_t>> Bytes;
+    uint64_t BusyUntil = 0;
+    double DropRate = 0.0;
+    double CorruptRate = 0.0;
+    
+    void Send(uint8_t value)
+    {
+        const uint64_t now = Shim::Now();
+        BusyUntil = (BusyUntil > now ? BusyUntil : now) + BYTE_TIME;
+        if (chance(DropRate)) return;
+        if (chance(CorruptRate)) value ^= 1 << (randomEngine() % 8);
+        Bytes.push_back(std::make_pair(BusyUntil, value));
+    }
+};
+
+class Port : public Stream
+{
+public:
+    Link* In = nullptr;
+    Link* Out = nullptr;
+    
+    int available()
+    {
+        int count = 0;
+        if (In)
+        {
+            for (auto& byte : In->Bytes)
+            {
+                if (byte.first > Shim::Now()) break;
+                count++;
+            }
+        }
+        return count;
+    }
+    
+    int read()
+    {
+        if (available() == 0) return -1;
+        const uint8_t value = In->Bytes.front().second;
+        In->Bytes.pop_front();
+        return value;
+    }
+    
+    int peek()
+    {
+        return available() > 0 ? In->Bytes.front().second : -1;
+    }
+    
+    size_t write(uint8_t value)
+    {
+        if (Out) Out->Send(value);
+        return 1;
+    }
+    using Print::write;
+};
+
+struct SentEvent
+{
+    uint8_t Satellite;
+    uint8_t Type;
+    unsigned long Time; // ms
+    bool Received;
+};
+
+struct ChainResult
+{
+    int Sent;
+    int Received;
+    int Unknown;    // received events that were never sent
+    int OutOfOrder;
+    unsigned long MaxError; // ms
+    unsigned int LostFrames;
+};
+
+// Master and satellites 1..count in a chain, every satellite sends events at random times
+static ChainResult runChain(const int count, const double dropRate, const double corruptRate)
+{
+    Shim::Reset(1000000);
+    
+    std::vector<Link> links(count + 1); // links[i] goes from satellite i towards the master
+    std::vector<Port> ports(count + 1);
+    std::vector<VbsButtonBus*> nodes;
+    for (int i = 0; i <= count; i++)
+    {
+        links[i].DropRate = dropRate;
+        links[i].CorruptRate = corruptRate;
+        ports[i].In = i < count ? &links[i + 1] : nullptr;
+        ports[i].Out = i > 0 ? &links[i] : nullptr;
+        nodes.push_back(new VbsButtonBus(ports[i], i));
+    }
+    
+    // Far satellites are several store-and-forward hops away, hold events back long enough
+    nodes[0]->SetHoldBackTime(40);
+    
+    std::vector<SentEvent> sent;
+    std::vector<VbsBusEvent> received;
+    const uint64_t end = Shim::Now() + 20000000;
+    while (Shim::Now() < end)
+    {
+        Shim::Advance(50);
+        for (int i = count; i >= 1; i--)
+        {
+            // About one event per satellite per 400 ms
+            if (Shim::Now() < end - 1000000 && chance(50.0 / 400000.0))
+            {
+                const uint8_t type = BUS_EVENT_PRESS + randomEngine() % 6;
+                sent.push_back({ (uint8_t)i, type, millis(), false });
+                nodes[i]->SendEvent(type);
+            }
+            nodes[i]->Update();
+        }
+        nodes[0]->Update();
+        
+        VbsBusEvent event;
+        while (nodes[0]->PollEvent(event))
+        {
+            received.push_back(event);
+        }
+    }
+    
+    ChainResult result = {};
+    result.Sent = sent.size();
+    result.Received = received.size();
+    result.LostFrames = nodes[0]->GetLostFrames();
+    for (size_t i = 0; i < received.size(); i++)
+    {
+        const VbsBusEvent& event = received[i];
+        if (i > 0 && (long)(event.Timestamp - received[i - 1].Timestamp) < 0) result.OutOfOrder++;
+        
+        // The master sees the satellite clock late by the fastest transfer, so timestamps only come later
+        bool found = false;
+        for (auto& candidate : sent)
+        {
+            const unsigned long error = event.Timestamp - candidate.Time;
+            if (candidate.Received || candidate.Satellite != event.Satellite || candidate.Type != event.Type || error > 20) continue;
+            candidate.Received = true;
+            found = true;
+            if (error > result.MaxError) result.MaxError = error;
+            break;
+        }
+        if (!found) result.Unknown++;
+    }
+    
+    for (auto node : nodes)
+    {
+        delete node;
+    }
+    
+    printf("%2d satellites, drop %.4f, corrupt %.4f: %d/%d events, %d unknown, %d out of order, max error %lu ms, %u lost\n",
+        count, dropRate, corruptRate, result.Received, result.Sent, result.Unknown, result.OutOfOrder,
+        result.MaxError, result.LostFrames);
+    return result;
+}
+
+static void testCleanChain()
+{
+    const ChainResult result = runChain(BUS_MAX_SATELLITES - 1, 0.0, 0.0);
+    CHECK(result.Sent > 500);
+    CHECK(result.Received == result.Sent);
+    CHECK(result.Unknown == 0);
+    CHECK(result.OutOfOrder == 0);
+    CHECK(result.MaxError <= 10);
+    CHECK(result.LostFrames == 0);
+}
+
+static void testNoisyChain()
+{
+    // A frame from the far end crosses every link, so even this little noise loses some of them
+    const ChainResult result = runChain(BUS_MAX_SATELLITES - 1, 0.0002, 0.0005);
+    CHECK(result.LostFrames > 0);
+    CHECK(result.Received > result.Sent * 8 / 10);
+    CHECK(result.Unknown == 0);
+    CHECK(result.OutOfOrder == 0);
+}
+
+// Frame of one event from a fresh satellite, as it goes on the wire
+static std::vector<uint8_t> captureFrame(const uint8_t satellite, const uint8_t type)
+{
+    Link link;
+    Port port;
+    port.Out = &link;
+    VbsButtonBus bus(port, satellite);
+    
+    bus.SendEvent(type);
+    Shim::Advance(10000);
+    bus.Update();
+    
+    std::vector<uint8_t> frame;
+    for (auto& byte : link.Bytes)
+    {
+        frame.push_back(byte.second);
+    }
+    return frame;
+}
+
+// Feeds the bytes to a fresh master and returns the events it finds
+static std::vector<VbsBusEvent> receiveBytes(const std::vector<uint8_t>& bytes)
+{
+    Link link;
+    Port port;
+    port.In = &link;
+    VbsButtonBus bus(port, BUS_MASTER);
+    
+    for (uint8_t value : bytes)
+    {
+        link.Bytes.push_back(std::make_pair(0, value));
+    }
+    std::vector<VbsBusEvent> events;
+    for (int i = 0; i < 100; i++)
+    {
+        bus.Update();
+        VbsBusEvent event;
+        while (bus.PollEvent(event))
+        {
+            events.push_back(event);
+        }
+        Shim::Advance(1000);
+    }
+    return events;
+}
+
+static void testResync()
+{
+    Shim::Reset(1000000);
+    const std::vector<uint8_t> frame = captureFrame(3, BUS_EVENT_CLICK);
+    CHECK(frame.size() == BUS_HEADER_SIZE + BUS_EVENT_SIZE + 1);
+    CHECK(frame[0] == BUS_SYNC);
+    
+    // Clean frame
+    std::vector<VbsBusEvent> events = receiveBytes(frame);
+    CHECK(events.size() == 1 && events[0].Satellite == 3 && events[0].Type == BUS_EVENT_CLICK);
+    
+    // Stray sync with an impossible event count right before the frame
+    std::vector<uint8_t> bytes = { BUS_SYNC, 0x01, 0x02, 0xFF };
+    bytes.insert(bytes.end(), frame.begin(), frame.end());
+    events = receiveBytes(bytes);
+    CHECK(events.size() == 1 && events[0].Satellite == 3);
+    
+    // Stray sync with a plausible header, its CRC byte falls inside the real frame
+    bytes = { 0x17, BUS_SYNC, 0x02, 0x00, 0x00 };
+    bytes.insert(bytes.end(), frame.begin(), frame.end());
+    events = receiveBytes(bytes);
+    CHECK(events.size() == 1 && events[0].Satellite == 3);
+    
+    // Corrupted frame followed by a good one: only the corrupted one is lost
+    const std::vector<uint8_t> next = captureFrame(4, BUS_EVENT_DOUBLE_CLICK);
+    bytes = frame;
+    bytes[BUS_HEADER_SIZE] ^= 0x40;
+    bytes.insert(bytes.end(), next.begin(), next.end());
+    events = receiveBytes(bytes);
+    CHECK(events.size() == 1 && events[0].Satellite == 4 && events[0].Type == BUS_EVENT_DOUBLE_CLICK);
+    
+    // Truncated frame (bytes dropped on the wire) followed by a good one
+    bytes.assign(frame.begin(), frame.begin() + 6);
+    bytes.insert(bytes.end(), next.begin(), next.end());
+    events = receiveBytes(bytes);
+    CHECK(events.size() == 1 && events[0].Satellite == 4);
+}
+
+int main()
+{
+    testResync();
+    testCleanChain();
+    testNoisyChain();
+    return CHECK_RESULT();
+}
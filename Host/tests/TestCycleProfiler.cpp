@@ -0,0 +1,158 @@
+/*
+    TestCycleProfiler.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    The cycle profiler of the AVR benchmark on a hand-made instruction trace: nested calls, an
+    interrupt in the middle of a function, a tail call that must not count as a call, and the
+    symbol table as avr-nm prints it. (The benchmark itself needs simavr and an AVR build.)
+*/
+
+#include "Check.h"
+#include <VbsCycleProfiler.h>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+static const char* SYMBOLS =
+    "00000050 T main\n"
+    "00000100 T loop()\n"
+    "00000200 T VbsBigRedButton::readButton()\n"
+    "00000200 T VbsBigRedButton::readButtonAlias()\n"
+    "00000300 T analogRead\n"
+    "00000400 T __vector_32\n"
+    "00000500 t helper()\n"
+    "00800100 B Keyboard\n"
+    "         U undefined\n";
+
+// Just enough of an AVR to push and pop return addresses
+struct Cpu
+{
+    uint8_t Data[0x900];
+    uint16_t Sp = 0x8FF;
+    uint32_t Pc = 0x50;
+    uint64_t Cycle = 0;
+    VbsCycleProfiler& Profiler;
+    
+    Cpu(VbsCycleProfiler& profiler) : Profiler(profiler)
+    {
+        memset(Data, 0, sizeof(Data));
+    }
+    
+    void Step(const uint32_t pc, const uint64_t cycles)
+    {
+        Pc = pc;
+        Cycle += cycles;
+        Profiler.Step(Pc, Sp, Data, Cycle);
+    }
+    
+    // Pushes the word address of the next instruction, low byte first, like CALL and interrupts
+    void Push(const uint32_t returnPc)
+    {
+        Data[Sp--] = (returnPc / 2) & 0xFF;
+        Data[Sp--] = (returnPc / 2) >> 8;
+    }
+    
+    void Call(const uint32_t target, const uint64_t cycles)
+    {
+        Push(Pc + 4);
+        Step(target, cycles);
+    }
+    
+    void Interrupt(const uint32_t vector, const uint32_t handler)
+    {
+        Push(Pc);
+        Step(vector, 5);
+        Step(handler, 3);
+    }
+    
+    void Return(const uint64_t cycles)
+    {
+        Sp += 2;
+        const uint32_t returnPc = ((uint32_t)Data[Sp - 1] << 8 | Data[Sp]) * 2;
+        Step(returnPc, cycles);
+    }
+};
+
+static void testSymbols()
+{
+    VbsCycleProfiler profiler;
+    std::istringstream symbols(SYMBOLS);
+    const int added = profiler.AddFunctions(symbols, { "loop", "VbsBigRedButton::*", "analogRead", "__vector_*", "Keyboard" });
+    CHECK(added == 4);
+    CHECK(profiler.Find("loop") != nullptr);
+    CHECK(profiler.Find("VbsBigRedButton::readButton") != nullptr);
+    CHECK(profiler.Find("VbsBigRedButton::readButtonAlias") == nullptr);
+    CHECK(profiler.Find("helper") == nullptr);
+    CHECK(profiler.Find("main") == nullptr);
+    CHECK(profiler.Find("Keyboard") == nullptr);
+    CHECK(profiler.Find("__vector_32") != nullptr && profiler.Find("__vector_32")->Interrupt);
+    CHECK(!profiler.Find("analogRead")->Interrupt);
+}
+
+static void testTrace()
+{
+    VbsCycleProfiler profiler;
+    std::istringstream symbols(SYMBOLS);
+    profiler.AddFunctions(symbols, { "loop", "VbsBigRedButton::*", "analogRead", "__vector_*" });
+    Cpu cpu(profiler);
+    
+    for (int i = 0; i < 2; i++)
+    {
+        // main -> loop -> readButton -> analogRead, interrupted once
+        cpu.Step(0x60, 10);
+        cpu.Call(0x100, 4);             // loop starts
+        cpu.Step(0x120, 10);
+        cpu.Call(0x200, 4);             // readButton starts
+        cpu.Step(0x210, 6);
+        cpu.Call(0x300, 4);             // analogRead starts
+        cpu.Step(0x310, 2);
+        cpu.Interrupt(0x80, 0x400);     // interrupt, 8 cycles to the handler
+        cpu.Step(0x420, 40);
+        cpu.Return(5);                  // reti: 45 cycles in the handler
+        cpu.Step(0x320, 100);
+        cpu.Return(4);                  // analogRead: 2 + 8 + 45 + 100 + 4 cycles
+        
+        // Tail call: readButton jumps to analogRead, which returns straight to loop
+        cpu.Step(0x250, 10);
+        cpu.Step(0x300, 3);
+        cpu.Step(0x330, 20);
+        cpu.Return(4);                  // readButton: 6 + 4 + 159 + 10 + 3 + 20 + 4 cycles
+        cpu.Step(0x130, 30);
+        cpu.Return(4);                  // loop: 10 + 4 + 206 + 30 + 4 cycles
+    }
+    
+    const VbsCycleProfiler::Function* loop = profiler.Find("loop");
+    const VbsCycleProfiler::Function* readButton = profiler.Find("VbsBigRedButton::readButton");
+    const VbsCycleProfiler::Function* analogRead = profiler.Find("analogRead");
+    const VbsCycleProfiler::Function* interrupt = profiler.Find("__vector_32");
+    CHECK(loop->Calls == 2 && loop->Cycles == 2 * 254 && loop->MaxCycles == 254);
+    CHECK(readButton->Calls == 2 && readButton->Cycles == 2 * 206);
+    CHECK(analogRead->Calls == 2 && analogRead->Cycles == 2 * 159);
+    CHECK(interrupt->Calls == 2 && interrupt->Cycles == 2 * 45);
+    printf("loop %lu/%llu, readButton %lu/%llu, analogRead %lu/%llu, interrupt %lu/%llu\n",
+        loop->Calls, (unsigned long long)loop->Cycles, readButton->Calls, (unsigned long long)readButton->Cycles,
+        analogRead->Calls, (unsigned long long)analogRead->Cycles, interrupt->Calls, (unsigned long long)interrupt->Cycles);
+    
+    // Cleared in the middle of loop: the running call still counts, in full
+    cpu.Step(0x60, 10);
+    cpu.Call(0x100, 4);
+    profiler.ClearCounters();
+    cpu.Step(0x120, 50);
+    cpu.Return(4);
+    CHECK(loop->Calls == 1 && loop->Cycles == 54);
+    CHECK(readButton->Calls == 0);
+    
+    // After a reset nothing from before is running
+    cpu.Call(0x100, 4);
+    profiler.Reset();
+    cpu.Return(4);
+    CHECK(loop->Calls == 0);
+}
+
+int main()
+{
+    testSymbols();
+    testTrace();
+    return CHECK_RESULT();
+}
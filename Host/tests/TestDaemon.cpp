@@ -0,0 +1,177 @@
+/*
+    TestDaemon.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    The daemon reading the emulated firmware through a stand-in of a hidraw node (a seqpacket
+    socket, one report per read), dispatching the actions, measuring the latency.
+*/
+
+#include "Check.h"
+#include <VbsDaemon.h>
+#include <VbsEmulator.h>
+#include <Shim.h>
+#include <sstream>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <VbsKeyboard.h>
+
+struct Spawned
+{
+    std::string Command;
+    std::vector<std::string> Environment;
+};
+
+static bool hasVariable(const Spawned& spawned, const std::string& variable)
+{
+    for (const std::string& value : spawned.Environment)
+    {
+        if (value == variable) return true;
+    }
+    return false;
+}
+
+// Two buttons, the one pressed first reports last
+static void testFirstPress()
+{
+    std::istringstream config("first run echo first\n");
+    VbsActionMap actions;
+    std::string error;
+    CHECK(actions.Load(config, error));
+    
+    VbsDaemon::Options options;
+    options.Discover = false;
+    options.HandleSignals = false;
+    VbsDaemon daemon(actions, options);
+    CHECK(daemon.Start(error));
+    
+    std::vector<Spawned> spawned;
+    daemon.SetSpawner([&](const std::string& command, const std::vector<std::string>& environment) {
+        spawned.push_back({ command, environment });
+        return true;
+    });
+    
+    int first[2];
+    int second[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, first) == 0);
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, second) == 0);
+    CHECK(daemon.AddDevice(first[0], "standin1", "button-1"));
+    CHECK(daemon.AddDevice(second[0], "standin2", "button-2"));
+    
+    // Key report, then the press time on the host clock (VENDOR_PRESS_TIME)
+    const uint32_t now = (uint32_t)VbsArbiter::HostClock();
+    const uint8_t key[9] = { HID_REPORTID_KEYBOARD, 0, 0, KEY_F13, 0, 0, 0, 0, 0 };
+    auto pressTime = [](const uint32_t time) {
+        return std::vector<uint8_t>{ HID_REPORTID_VENDOR, VENDOR_PRESS_TIME, (uint8_t)time, (uint8_t)(time >> 8), (uint8_t)(time >> 16), (uint8_t)(time >> 24), 0, 0, 0 };
+    };
+    const std::vector<uint8_t> time1 = pressTime(now - 1000);
+    const std::vector<uint8_t> time2 = pressTime(now - 1400);
+    send(first[1], key, sizeof(key), 0);
+    send(first[1], time1.data(), time1.size(), 0);
+    daemon.RunOnce(0);
+    send(second[1], key, sizeof(key), 0);
+    send(second[1], time2.data(), time2.size(), 0);
+    
+    for (int i = 0; i < 100 && spawned.empty(); i++) daemon.RunOnce(10);
+    CHECK(spawned.size() == 1);
+    if (spawned.size() == 1)
+    {
+        CHECK(spawned[0].Command == "echo first");
+        CHECK(hasVariable(spawned[0], "BRB_DEVICE=button-2"));
+        CHECK(hasVariable(spawned[0], "BRB_EVENT=first"));
+        CHECK(hasVariable(spawned[0], "BRB_CODE=400"));
+        CHECK(hasVariable(spawned[0], "BRB_VALUE=2"));
+    }
+    
+    close(first[1]);
+    close(second[1]);
+}
+
+int main()
+{
+    testFirstPress();
+    
+    // Listener of the socket action
+    const std::string socketPath = "/tmp/brb-test-" + std::to_string(getpid()) + ".sock";
+    const int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socketPath.c_str());
+    CHECK(bind(listener, (sockaddr*)&address, sizeof(address)) == 0);
+    CHECK(listen(listener, 8) == 0);
+    
+    std::istringstream config(
+        "key F13     run echo single\n"
+        "key F14     play /tmp/double.wav\n"
+        "key F14     socket " + socketPath + " double\n"
+        "keyup *     run true\n");
+    VbsActionMap actions;
+    std::string error;
+    CHECK(actions.Load(config, error));
+    
+    VbsDaemon::Options options;
+    options.Discover = false;
+    options.HandleSignals = false;
+    options.Player = "player";
+    VbsDaemon daemon(actions, options);
+    CHECK(daemon.Start(error));
+    
+    std::vector<Spawned> spawned;
+    daemon.SetSpawner([&](const std::string& command, const std::vector<std::string>& environment) {
+        spawned.push_back({ command, environment });
+        return true;
+    });
+    
+    // Keyboard interface of the emulated button into the stand-in
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == 0);
+    CHECK(daemon.AddDevice(pair[0], "standin0", "button-1"));
+    
+    VbsEmulator emulator;
+    Shim::SetPacketHandler([&](const Shim::Packet& packet) {
+        if (packet.Endpoint == Shim::GetEndpoint(0)) send(pair[1], packet.Data.data(), packet.Data.size(), 0);
+    });
+    emulator.SetIdleHandler([&]() { daemon.RunOnce(0); });
+    emulator.Start();
+    
+    std::istringstream script("switch 2\nwait 300\ntap 100 600\ntap 80 100\ntap 80 300\n");
+    CHECK(emulator.RunScript(script, error));
+    
+    // Single click, release, double click (2 actions), release
+    CHECK(spawned.size() == 4);
+    if (spawned.size() == 4)
+    {
+        CHECK(spawned[0].Command == "echo single");
+        CHECK(hasVariable(spawned[0], "BRB_DEVICE=button-1"));
+        CHECK(hasVariable(spawned[0], "BRB_EVENT=key"));
+        CHECK(hasVariable(spawned[0], "BRB_CODE=104"));
+        CHECK(spawned[1].Command == "true" && hasVariable(spawned[1], "BRB_EVENT=keyup"));
+        CHECK(spawned[2].Command == "player '/tmp/double.wav'");
+        CHECK(spawned[3].Command == "true");
+    }
+    
+    const int connection = accept(listener, NULL, NULL);
+    CHECK(connection >= 0);
+    char line[64] = {};
+    CHECK(read(connection, line, sizeof(line) - 1) > 0);
+    CHECK(strcmp(line, "double\n") == 0);
+    close(connection);
+    
+    // Every action is timed, dispatching is quick
+    const VbsLatencyStats latency = daemon.GetLatency();
+    CHECK(latency.Count == 5);
+    CHECK(latency.Max < 50000.0);
+    
+    // Closing the other end is like unplugging
+    close(pair[1]);
+    daemon.RunOnce(100);
+    CHECK(daemon.GetDeviceCount() == 0);
+    
+    close(listener);
+    unlink(socketPath.c_str());
+    return CHECK_RESULT();
+}
@@ -0,0 +1,130 @@
+/*
+    TestDaemonUhid.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    The daemon finding the emulated button among the hidraw nodes of the kernel (created through
+    /dev/uhid) by its USB IDs, reading both of its interfaces and syncing its clock for the
+    first-press arbitration. The daemon runs on its own thread, the clock sync waits for the
+    emulator to answer. Skipped without access to /dev/uhid.
+*/
+
+#include "Check.h"
+#include <VbsDaemon.h>
+#include <VbsEmulator.h>
+#include <VbsUhid.h>
+#include <Shim.h>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <sstream>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <VbsBigRedButton.h>
+
+// The sketch's instance
+extern VbsBigRedButton BigRedButton;
+
+int main()
+{
+    const int probe = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+    if (probe < 0)
+    {
+        fprintf(stderr, "/dev/uhid: %s, skipped\n", strerror(errno));
+        return TEST_SKIPPED;
+    }
+    close(probe);
+    
+    std::istringstream config("key F13 run echo single\nfirst run echo first\n");
+    VbsActionMap actions;
+    std::string error;
+    CHECK(actions.Load(config, error));
+    
+    VbsDaemon::Options options;
+    options.HandleSignals = false;
+    options.SyncPeriod = 100;
+    VbsDaemon daemon(actions, options);
+    
+    std::mutex mutex;
+    std::vector<std::pair<std::string, std::string>> spawned;
+    std::atomic<int> pressTimes(0);
+    daemon.SetSpawner([&](const std::string& command, const std::vector<std::string>& environment) {
+        std::lock_guard<std::mutex> lock(mutex);
+        spawned.push_back({ command, environment[0] });
+        return true;
+    });
+    daemon.SetEventHandler([&](const std::string&, const VbsEvent& event, uint64_t) {
+        if (event.Type == EVENT_PRESS_TIME) pressTimes++;
+    });
+    
+    VbsEmulator emulator;
+    VbsUhid devices[2];
+    emulator.Start();
+    BigRedButton.SetPressTimestamps(true);
+    
+    const std::string unique = "brb-daemon-test-" + std::to_string(getpid());
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t interface = Shim::GetInterface(i);
+        const uint8_t endpoint = Shim::GetEndpoint(i);
+        Shim::SetEndpointPolled(endpoint, false);
+        devices[i].OnOpen = [endpoint](bool open) { Shim::SetEndpointPolled(endpoint, open); };
+        devices[i].OnSetReport = [interface](uint8_t type, const std::vector<uint8_t>& data) {
+            if (!data.empty()) Shim::SetReport(interface, type, data[0], data);
+        };
+        CHECK(devices[i].Create("Big Red Button test", unique + "/input" + std::to_string(i), unique,
+            Shim::GetReportDescriptor(interface)));
+    }
+    Shim::SetPacketHandler([&](const Shim::Packet& packet) {
+        devices[packet.Endpoint == Shim::GetEndpoint(0) ? 0 : 1].SendInput(packet.Data);
+    });
+    emulator.SetIdleHandler([&]() {
+        for (int i = 0; i < 2; i++) devices[i].Process();
+    });
+    
+    // Hotplug: the daemon starts first, the nodes show up a bit later
+    CHECK(daemon.Start(error));
+    std::atomic<bool> stop(false);
+    std::thread loop([&]() {
+        while (!stop) daemon.RunOnce(10);
+    });
+    
+    // (Real time, so the kernel keeps up)
+    auto run = [&](const int ms) {
+        for (int i = 0; i < ms / 10; i++)
+        {
+            emulator.Run(10000);
+            usleep(10000);
+        }
+    };
+    run(1000);
+    
+    std::istringstream script("switch 2\nwait 300\ntap 100 600\n");
+    std::string line;
+    while (std::getline(script, line))
+    {
+        CHECK(emulator.RunScriptLine(line, error));
+        usleep(10000);
+    }
+    run(500);
+    
+    stop = true;
+    loop.join();
+    if (spawned.empty() && geteuid() != 0)
+    {
+        fprintf(stderr, "hidraw nodes not accessible, skipped\n");
+        return TEST_SKIPPED;
+    }
+    
+    // Synced, so the press came with a timestamp and won its round
+    CHECK(pressTimes == 1);
+    CHECK(spawned.size() == 2);
+    for (const auto& action : spawned)
+    {
+        CHECK(action.first == "echo first" || action.first == "echo single");
+        CHECK(action.second == "BRB_DEVICE=" + unique);
+    }
+    return CHECK_RESULT();
+}
@@ -0,0 +1,92 @@
+/*
+    TestEmulator.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    The sketch on the emulator: scripted presses come out as the keyboard reports of the program.
+*/
+
+#include "Check.h"
+#include <VbsEmulator.h>
+#include <Shim.h>
+#include <sstream>
+#include <vector>
+#include <VbsKeyboard.h>
+
+static std::vector<Shim::Packet> packets;
+
+// First key of the keyboard reports after the given time, in order (0 for a release)
+static std::vector<uint8_t> keysAfter(const uint64_t time)
+{
+    std::vector<uint8_t> keys;
+    for (const Shim::Packet& packet : packets)
+    {
+        if (packet.Time < time || packet.Endpoint != Shim::GetEndpoint(0)) continue;
+        if (packet.Data.size() == 1 + sizeof(KeyReportPage7) && packet.Data[0] == HID_REPORTID_KEYBOARD) keys.push_back(packet.Data[3]);
+    }
+    return keys;
+}
+
+static void runScript(VbsEmulator& emulator, const char* script)
+{
+    std::istringstream stream(script);
+    std::string error;
+    const bool ok = emulator.RunScript(stream, error);
+    if (!ok) fprintf(stderr, "%s\n", error.c_str());
+    CHECK(ok);
+}
+
+int main()
+{
+    VbsEmulator emulator;
+    Shim::SetPacketHandler([](const Shim::Packet& packet) { packets.push_back(packet); });
+    emulator.Start();
+    
+    // Both interfaces with a report descriptor starting with a usage page
+    const std::vector<uint8_t> keyboardDescriptor = Shim::GetReportDescriptor(Shim::GetInterface(0));
+    const std::vector<uint8_t> vendorDescriptor = Shim::GetReportDescriptor(Shim::GetInterface(1));
+    CHECK(keyboardDescriptor.size() > 2 && keyboardDescriptor[0] == 0x05);
+    CHECK(vendorDescriptor.size() > 2 && vendorDescriptor[0] == 0x06);
+    
+    // Program 0: Enter while held (the repeat releases it on the next frame)
+    runScript(emulator, "wait 300");
+    uint64_t start = Shim::Now();
+    runScript(emulator, "press\nwait 100");
+    const std::vector<uint8_t> press = keysAfter(start);
+    CHECK(press.size() >= 1 && press[0] == KEY_ENTER);
+    for (const Shim::Packet& packet : packets)
+    {
+        // Reported within 2 frames of the press
+        if (packet.Time >= start && packet.Data.size() > 3 && packet.Data[3] == KEY_ENTER) CHECK(packet.Time - start <= 2000);
+    }
+    runScript(emulator, "release\nwait 100");
+    
+    // Program 2: single click after the double click time, double click right away
+    runScript(emulator, "switch 2\nwait 50");
+    start = Shim::Now();
+    runScript(emulator, "tap 100 600\ntap 80 100\ntap 80 600");
+    std::vector<uint8_t> keys = keysAfter(start);
+    CHECK(keys.size() == 4);
+    CHECK(keys.size() == 4 && keys[0] == KEY_F13 && keys[1] == 0 && keys[2] == KEY_F14 && keys[3] == 0);
+    
+    // Long press
+    start = Shim::Now();
+    runScript(emulator, "tap 900 600");
+    keys = keysAfter(start);
+    CHECK(keys.size() == 2 && keys[0] == KEY_F15);
+    
+    // Scroll Lock keeps the LED lit (the LED pin sinks the current, 255 is dark)
+    runScript(emulator, "leds 0\nwait 500");
+    const int dark = 255 - Shim::GetPwm(EMULATOR_PIN_LIGHT);
+    runScript(emulator, "leds 4\nwait 500");
+    const int lit = 255 - Shim::GetPwm(EMULATOR_PIN_LIGHT);
+    CHECK(lit > dark + 64);
+    
+    // Bad script lines are reported
+    std::istringstream bad("wait 10\nsmash\n");
+    std::string error;
+    CHECK(!emulator.RunScript(bad, error));
+    CHECK(error.find("line 2") == 0);
+    
+    return CHECK_RESULT();
+}
@@ -0,0 +1,129 @@
+/*
+    TestLongPressStages.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    Long press stages on the emulator: every stage fires its key at its deadline measured from the
+    press, GetLongPressProgress() climbs from 0 to 100 towards each of them and starts over after one
+    is reached, and a release in between cancels the stages still ahead.
+*/
+
+#include "Check.h"
+#include <VbsEmulator.h>
+#include <Shim.h>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+#include <VbsBigRedButton.h>
+
+// The sketch's instance
+extern VbsBigRedButton BigRedButton;
+
+#define STAGE_1 700
+#define STAGE_2 1500
+#define STAGE_3 2500
+
+// Detection of the press and the 10 ms steps of the script
+#define TOLERANCE 30
+
+struct KeyPress
+{
+    uint64_t Time;
+    uint8_t Key;
+};
+
+static std::vector<KeyPress> keys;
+
+static void runScript(VbsEmulator& emulator, const char* script)
+{
+    std::istringstream stream(script);
+    std::string error;
+    const bool ok = emulator.RunScript(stream, error);
+    if (!ok) fprintf(stderr, "%s\n", error.c_str());
+    CHECK(ok);
+}
+
+// Time of the first report of the key after the given time, in ms, -1 if there was none
+static long keyTime(const uint8_t key, const uint64_t since)
+{
+    for (const KeyPress& press : keys)
+    {
+        if (press.Time >= since && press.Key == key) return (long)((press.Time - since) / 1000);
+    }
+    return -1;
+}
+
+static bool near(const long value, const long expected, const long tolerance)
+{
+    return value >= expected && value <= expected + tolerance;
+}
+
+int main()
+{
+    VbsEmulator emulator;
+    Shim::SetPacketHandler([](const Shim::Packet& packet)
+    {
+        if (packet.Endpoint == Shim::GetEndpoint(0) && packet.Data.size() == 9 && packet.Data[0] == HID_REPORTID_KEYBOARD && packet.Data[3])
+        {
+            keys.push_back({ packet.Time, packet.Data[3] });
+        }
+    });
+    emulator.Start();
+    BigRedButton.SetLongPressStages(STAGE_2, STAGE_3);
+    BigRedButton.SetKeyMapping(2, GESTURE_LONG_PRESS_STAGE_2, KEY_F18);
+    BigRedButton.SetKeyMapping(2, GESTURE_LONG_PRESS_STAGE_3, KEY_F19);
+    runScript(emulator, "switch 2\nwait 300");
+    CHECK(BigRedButton.GetLongPressProgress() == 0);
+
+    // Held through all three stages, the progress sampled every 10 ms
+    const uint64_t start = Shim::Now();
+    runScript(emulator, "press");
+    std::vector<int> progress;
+    for (int ms = 0; ms < STAGE_3 + 200; ms += 10)
+    {
+        runScript(emulator, "wait 10");
+        progress.push_back(BigRedButton.GetLongPressProgress());
+    }
+    runScript(emulator, "release\nwait 600");
+
+    const long stage1 = keyTime(KEY_F15, start);
+    const long stage2 = keyTime(KEY_F18, start);
+    const long stage3 = keyTime(KEY_F19, start);
+    printf("stages at %ld, %ld, %ld ms\n", stage1, stage2, stage3);
+    CHECK(near(stage1, STAGE_1, TOLERANCE));
+    CHECK(near(stage2, STAGE_2, TOLERANCE));
+    CHECK(near(stage3, STAGE_3, TOLERANCE));
+
+    // Halfway to every stage, full after the last one, and climbing in between
+    const auto progressAt = [&](const int ms) { return progress[ms / 10 - 1]; };
+    printf("progress %d, %d, %d, %d\n", progressAt(STAGE_1 / 2), progressAt((STAGE_1 + STAGE_2) / 2),
+        progressAt((STAGE_2 + STAGE_3) / 2), progressAt(STAGE_3 + 100));
+    CHECK(progressAt(STAGE_1 / 2) >= 45 && progressAt(STAGE_1 / 2) <= 55);
+    CHECK(progressAt((STAGE_1 + STAGE_2) / 2) >= 45 && progressAt((STAGE_1 + STAGE_2) / 2) <= 55);
+    CHECK(progressAt((STAGE_2 + STAGE_3) / 2) >= 45 && progressAt((STAGE_2 + STAGE_3) / 2) <= 55);
+    CHECK(progressAt(STAGE_3 + 100) == 100);
+    int drops = 0;
+    for (size_t i = 1; i < progress.size(); i++)
+    {
+        if (progress[i] < progress[i - 1]) drops++;
+    }
+    CHECK(drops == 2);
+    CHECK(BigRedButton.GetLongPressProgress() == 0);
+
+    // Released between the first two stages: the long press fires, the rest does not
+    const uint64_t cancelled = Shim::Now();
+    runScript(emulator, "tap 1000 2000");
+    CHECK(near(keyTime(KEY_F15, cancelled), STAGE_1, TOLERANCE));
+    CHECK(keyTime(KEY_F18, cancelled) == -1);
+    CHECK(keyTime(KEY_F19, cancelled) == -1);
+
+    // Without stages the long press is the only one, and its progress is full once it fired
+    BigRedButton.SetLongPressStages(0, 0);
+    const uint64_t single = Shim::Now();
+    runScript(emulator, "press\nwait 2700");
+    CHECK(BigRedButton.GetLongPressProgress() == 100);
+    runScript(emulator, "release\nwait 600");
+    CHECK(near(keyTime(KEY_F15, single), STAGE_1, TOLERANCE));
+    CHECK(keyTime(KEY_F18, single) == -1);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,56 @@
+/*
+    TestMultiDevice.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    brb-emulator with several devices: every one of them runs the script on its own board,
+    started with the given stagger.
+    
+    usage: TestMultiDevice <brb-emulator> <script>
+*/
+
+#include "Check.h"
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) return 2;
+    
+    const std::string command = std::string("'") + argv[1] + "' --devices 3 --stagger 50 --dump '" + argv[2] + "'";
+    FILE* output = popen(command.c_str(), "r");
+    CHECK(output != NULL);
+    if (!output) return CHECK_RESULT();
+    
+    // "<device> <ms> if<n> <bytes>": time of the F13 (single click) report of each device
+    std::map<int, double> singleClick;
+    std::map<int, int> reports;
+    char line[256];
+    while (fgets(line, sizeof(line), output))
+    {
+        std::istringstream words(line);
+        int device;
+        double time;
+        std::string interface;
+        std::vector<int> bytes;
+        unsigned int value;
+        words >> device >> time >> interface;
+        while (words >> std::hex >> value) bytes.push_back(value);
+        
+        reports[device]++;
+        if (interface == "if0" && bytes.size() == 9 && bytes[0] == 0x02 && bytes[3] == 0x68) singleClick[device] = time;
+    }
+    CHECK(pclose(output) == 0);
+    
+    CHECK(reports.size() == 3);
+    CHECK(singleClick.size() == 3);
+    if (singleClick.size() == 3)
+    {
+        // Same script, so the same time apart from the stagger
+        CHECK(singleClick[1] - singleClick[0] > 49.0 && singleClick[1] - singleClick[0] < 51.0);
+        CHECK(singleClick[2] - singleClick[1] > 49.0 && singleClick[2] - singleClick[1] < 51.0);
+    }
+    return CHECK_RESULT();
+}
@@ -0,0 +1,60 @@
+/*
+    TestPressVelocity.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Press velocity from the emulator with transitions of different speed: a slam that is over before
+    the press is even confirmed must still come out as the fastest, not as the minimum of 1, and the
+    velocity must fall as the transition gets slower.
+*/
+
+#include "Check.h"
+#include <VbsEmulator.h>
+#include <Shim.h>
+#include <stdio.h>
+#include <VbsBigRedButton.h>
+
+// The sketch's instance
+extern VbsBigRedButton BigRedButton;
+
+static int averageVelocity(VbsEmulator& emulator, const uint64_t transition)
+{
+    emulator.SetTransitionTime(transition);
+    int sum = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        // Presses start at different phases of the loop
+        emulator.Run(137 * (i + 1));
+        emulator.SetButton(true);
+        emulator.Run(100000);
+        sum += BigRedButton.GetPressVelocity();
+        emulator.SetButton(false);
+        emulator.Run(300000);
+    }
+    return sum / 8;
+}
+
+int main()
+{
+    VbsEmulator emulator;
+    emulator.Start();
+    BigRedButton.SetPressVelocitySampling(true);
+    emulator.Run(300000);
+    
+    const uint64_t transitions[] = { 50, 200, 800, 3000 };
+    int velocities[4];
+    for (int i = 0; i < 4; i++)
+    {
+        velocities[i] = averageVelocity(emulator, transitions[i]);
+        printf("transition %5llu us: velocity %d\n", (unsigned long long)transitions[i], velocities[i]);
+    }
+    
+    // A slam faster than the confirmation samples is the hardest press there is
+    CHECK(velocities[0] > 100);
+    for (int i = 1; i < 4; i++)
+    {
+        CHECK(velocities[i] <= velocities[i - 1]);
+    }
+    CHECK(velocities[0] > velocities[3] * 4);
+    return CHECK_RESULT();
+}
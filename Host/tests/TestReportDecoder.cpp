@@ -0,0 +1,129 @@
+/*
+    TestReportDecoder.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Reports to events, and events to the configured actions.
+*/
+
+#include "Check.h"
+#include <VbsActionMap.h>
+#include <VbsReportDecoder.h>
+#include <sstream>
+
+static std::vector<VbsEvent> decode(VbsReportDecoder& decoder, const std::vector<uint8_t>& report, bool* valid = NULL)
+{
+    std::vector<VbsEvent> events;
+    const bool ok = decoder.Decode(report.data(), report.size(), events);
+    if (valid) *valid = ok;
+    return events;
+}
+
+static void testDecoder()
+{
+    VbsReportDecoder decoder;
+    
+    // Key press with modifier, second key, release of the first, release of all
+    std::vector<VbsEvent> events = decode(decoder, { 0x02, 0x08, 0, 0x0F, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_KEY_DOWN && events[0].Code == 0x0F && events[0].Modifiers == 0x08);
+    events = decode(decoder, { 0x02, 0, 0, 0x0F, 0x68, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_KEY_DOWN && events[0].Code == 0x68);
+    events = decode(decoder, { 0x02, 0, 0, 0x68, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_KEY_UP && events[0].Code == 0x0F);
+    events = decode(decoder, { 0x02, 0, 0, 0, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_KEY_UP && events[0].Code == 0x68);
+    
+    // System key (16 bits, little-endian)
+    events = decode(decoder, { 0x04, 0x82, 0x00, 0, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_SYSTEM_DOWN && events[0].Code == 0x82);
+    events = decode(decoder, { 0x04, 0, 0, 0, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_SYSTEM_UP && events[0].Code == 0x82);
+    
+    // Gamepad: the first report tells the program, then button 3 and a program change
+    events = decode(decoder, { 0x03, 0, 2, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_PROGRAM && events[0].Value == 2);
+    events = decode(decoder, { 0x03, 0x04, 2, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_BUTTON_DOWN && events[0].Code == 3);
+    events = decode(decoder, { 0x03, 0, 1, 0 });
+    CHECK(events.size() == 2 && events[0].Type == EVENT_BUTTON_UP && events[1].Type == EVENT_PROGRAM && events[1].Value == 1);
+    
+    // Vendor reports
+    events = decode(decoder, { 0x05, 0x01, 200, 0, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_VELOCITY && events[0].Value == 200);
+    events = decode(decoder, { 0x05, 0x02, 7, 3, 0x78, 0x56, 0x34, 0x12, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_BUS && events[0].Code == 7 && events[0].Value == 3 && events[0].Time == 0x12345678);
+    events = decode(decoder, { 0x05, 0x03, 0x01, 0x02, 0x03, 0x04, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_PRESS_TIME && events[0].Time == 0x04030201);
+    events = decode(decoder, { 0x05, 0x04, 5, 0, 0, 0, 0, 0, 0 });
+    CHECK(events.size() == 1 && events[0].Type == EVENT_TAP_PATTERN && events[0].Code == 5);
+    
+    // Not reports of the button
+    bool valid = true;
+    decode(decoder, { 0x02, 0, 0 }, &valid);
+    CHECK(!valid);
+    decode(decoder, { 0x01, 0, 0, 0, 0, 0, 0, 0, 0 }, &valid);
+    CHECK(!valid);
+}
+
+static void testActionMap()
+{
+    CHECK(VbsActionMap::KeyCode("F13") == 0x68);
+    CHECK(VbsActionMap::KeyCode("f1") == 0x3A);
+    CHECK(VbsActionMap::KeyCode("A") == 0x04);
+    CHECK(VbsActionMap::KeyCode("0") == 0x27);
+    CHECK(VbsActionMap::KeyCode("enter") == 0x28);
+    CHECK(VbsActionMap::KeyCode("0x2C") == 0x2C);
+    CHECK(VbsActionMap::KeyCode("F25") == -1);
+    
+    std::istringstream config(
+        "# Quiz\n"
+        "key F13       run notify-send 'Single click'\n"
+        "key *         socket /tmp/brb.sock\n"
+        "keyup F13     run true\n"
+        "bus 2 click   play /tmp/buzzer.wav\n"
+        "bus * press   socket /tmp/brb.sock buzz\n"
+        "tap 3         run echo three   # trailing comment\n"
+        "velocity      run true\n"
+        "program 2     run true\n");
+    VbsActionMap map;
+    std::string error;
+    CHECK(map.Load(config, error));
+    CHECK(map.GetActions().size() == 8);
+    
+    std::vector<const VbsAction*> actions;
+    map.Match({ EVENT_KEY_DOWN, 0x68, 0, 0, 0 }, actions);
+    CHECK(actions.size() == 2 && actions[0]->Kind == ACTION_RUN && actions[0]->Target == "notify-send 'Single click'");
+    CHECK(actions.size() == 2 && actions[1]->Kind == ACTION_SOCKET && actions[1]->Target == "/tmp/brb.sock" && actions[1]->Text.empty());
+    
+    actions.clear();
+    map.Match({ EVENT_BUS, 2, 0, 3, 0 }, actions);
+    CHECK(actions.size() == 1 && actions[0]->Kind == ACTION_PLAY && actions[0]->Target == "/tmp/buzzer.wav");
+    actions.clear();
+    map.Match({ EVENT_BUS, 5, 0, 1, 0 }, actions);
+    CHECK(actions.size() == 1 && actions[0]->Text == "buzz");
+    
+    actions.clear();
+    map.Match({ EVENT_TAP_PATTERN, 3, 0, 0, 0 }, actions);
+    CHECK(actions.size() == 1 && actions[0]->Target == "echo three" && actions[0]->Line == 7);
+    
+    actions.clear();
+    map.Match({ EVENT_PROGRAM, 0, 0, 1, 0 }, actions);
+    CHECK(actions.empty());
+    
+    // Errors name the line
+    const char* bad[] = { "key F99 run x\n", "bus 1 run x\n", "button 9 run x\n", "key F13 explode\n", "key F13 run\n", "poke run x\n" };
+    for (const char* text : bad)
+    {
+        std::istringstream stream(std::string("\n") + text);
+        VbsActionMap other;
+        CHECK(!other.Load(stream, error));
+        CHECK(error.find("line 2") == 0);
+    }
+}
+
+int main()
+{
+    testDecoder();
+    testActionMap();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,144 @@
+/*
+    TestTypeString.cpp
+
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+
+    Background typing through the emulator: the keyboard reports of TypeString() have to spell the
+    text on a US layout, release between repeated letters and around modifier changes, and skip what
+    the layout cannot type. Then the throughput against typing the same text with PressKey().
+*/
+
+#include "Check.h"
+#include <VbsEmulator.h>
+#include <Shim.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <VbsKeyboard.h>
+
+// Repeated letters (ll, aa, AA), shift on and off, and characters the US layout has no key for
+static const char TEXT[] PROGMEM = "Hello, World!\x01 aaAAa\xc3\xa9 2024\n";
+static const char TYPED[] = "Hello, World! aaAAa 2024\n";
+
+struct KeyReport
+{
+    uint64_t Time;
+    uint8_t Modifiers;
+    uint8_t Key;
+};
+
+static std::vector<KeyReport> reports;
+
+// Key and modifiers of the characters of the text on the US layout
+static bool usKey(const char c, uint8_t& key, uint8_t& modifiers)
+{
+    modifiers = MOD_NONE;
+    if (c >= 'a' && c <= 'z') key = KEY_A + (c - 'a');
+    else if (c >= 'A' && c <= 'Z') { key = KEY_A + (c - 'A'); modifiers = MOD_LEFT_SHIFT; }
+    else if (c >= '1' && c <= '9') key = 0x1E + (c - '1');
+    else if (c == '0') key = 0x27;
+    else if (c == '!') { key = 0x1E; modifiers = MOD_LEFT_SHIFT; }
+    else if (c == ',') key = 0x36;
+    else if (c == ' ') key = KEY_SPACE;
+    else if (c == '\n') key = KEY_ENTER;
+    else return false;
+    return true;
+}
+
+// Keys as the host sees them: a character every time a key appears in the report
+static std::string decode(const size_t first, int& badReleases)
+{
+    std::string text;
+    uint8_t heldKey = 0;
+    uint8_t heldModifiers = 0;
+    badReleases = 0;
+    for (size_t i = first; i < reports.size(); i++)
+    {
+        const KeyReport& report = reports[i];
+        if (report.Key && report.Key != heldKey)
+        {
+            // Without a release in between, a modifier change would apply to the held key too
+            if (heldKey && report.Modifiers != heldModifiers) badReleases++;
+            
+            char c = '?';
+            for (int candidate = 0x0A; candidate < 0x7F; candidate++)
+            {
+                uint8_t key, modifiers;
+                if (usKey(candidate, key, modifiers) && key == report.Key && modifiers == report.Modifiers) c = candidate;
+            }
+            text += c;
+        }
+        heldKey = report.Key;
+        heldModifiers = report.Modifiers;
+    }
+    return text;
+}
+
+// Runs the sketch until the keyboard reports stop, returns the time of the last one
+static uint64_t runUntilQuiet(VbsEmulator& emulator)
+{
+    size_t count;
+    do
+    {
+        count = reports.size();
+        emulator.Run(20000);
+    } while (reports.size() != count);
+    return reports.empty() ? 0 : reports.back().Time;
+}
+
+int main()
+{
+    VbsEmulator emulator;
+    Shim::SetPacketHandler([](const Shim::Packet& packet)
+    {
+        if (packet.Endpoint == Shim::GetEndpoint(0) && packet.Data.size() == 9 && packet.Data[0] == HID_REPORTID_KEYBOARD)
+        {
+            reports.push_back({ packet.Time, packet.Data[1], packet.Data[3] });
+        }
+    });
+    emulator.Start();
+    emulator.Run(300000);
+    
+    // TypeString returns right away and types on the timer
+    reports.clear();
+    uint64_t start = Shim::Now();
+    CHECK(Keyboard.TypeString(reinterpret_cast<const __FlashStringHelper*>(TEXT)));
+    const uint64_t typeCall = Shim::Now() - start;
+    CHECK(Keyboard.IsTyping());
+    CHECK(!Keyboard.TypeString(reinterpret_cast<const __FlashStringHelper*>(TEXT)));
+    for (int i = 0; i < 1000 && Keyboard.IsTyping(); i++)
+    {
+        emulator.Run(1000);
+    }
+    CHECK(!Keyboard.IsTyping());
+    const uint64_t typeTime = runUntilQuiet(emulator) - start;
+    
+    int badReleases;
+    const std::string typed = decode(0, badReleases);
+    printf("typed \"%s\"\n", typed.c_str());
+    CHECK(typed == TYPED);
+    CHECK(badReleases == 0);
+    CHECK(!reports.empty() && reports.back().Key == 0 && reports.back().Modifiers == 0);
+    
+    // The same text with PressKey, which blocks while the endpoint is full
+    const size_t pressFirst = reports.size();
+    start = Shim::Now();
+    for (const char* c = TYPED; *c; c++)
+    {
+        uint8_t key = 0, modifiers;
+        usKey(*c, key, modifiers);
+        Keyboard.PressKey(key, modifiers);
+    }
+    const uint64_t pressCall = Shim::Now() - start;
+    const uint64_t pressTime = runUntilQuiet(emulator) - start;
+    CHECK(decode(pressFirst, badReleases) == TYPED);
+    
+    const size_t length = sizeof(TYPED) - 1;
+    printf("TypeString: %.0f chars/s, %llu us in the call; PressKey: %.0f chars/s, %llu us in the calls\n",
+        length * 1e6 / typeTime, (unsigned long long)typeCall, length * 1e6 / pressTime, (unsigned long long)pressCall);
+    
+    // Typing in the background costs the loop nothing, and is at least half as fast as blocking
+    CHECK(typeCall < 1000);
+    CHECK(typeTime < pressTime * 2);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,113 @@
+/*
+    TestUhid.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    The emulated button as a kernel device: the descriptor is accepted, a hidraw node shows up,
+    and a press arrives there as the keyboard report. Skipped without access to /dev/uhid.
+*/
+
+#include "Check.h"
+#include <VbsEmulator.h>
+#include <VbsUhid.h>
+#include <Shim.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <string.h>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+// hidraw node of the device with this unique id (HID_UNIQ in the uevent)
+static std::string findHidraw(const std::string& unique, const std::string& physical)
+{
+    DIR* directory = opendir("/sys/class/hidraw");
+    if (!directory) return "";
+    
+    std::string found;
+    while (dirent* entry = readdir(directory))
+    {
+        if (entry->d_name[0] == '.') continue;
+        std::ifstream uevent(std::string("/sys/class/hidraw/") + entry->d_name + "/device/uevent");
+        const std::string content((std::istreambuf_iterator<char>(uevent)), std::istreambuf_iterator<char>());
+        if (content.find("HID_UNIQ=" + unique + "\n") != std::string::npos && content.find("HID_PHYS=" + physical + "\n") != std::string::npos)
+        {
+            found = std::string("/dev/") + entry->d_name;
+        }
+    }
+    closedir(directory);
+    return found;
+}
+
+int main()
+{
+    const int probe = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+    if (probe < 0)
+    {
+        fprintf(stderr, "/dev/uhid: %s, skipped\n", strerror(errno));
+        return TEST_SKIPPED;
+    }
+    close(probe);
+    
+    VbsEmulator emulator;
+    VbsUhid devices[2];
+    emulator.Start();
+    for (int i = 0; i < 2; i++) Shim::SetEndpointPolled(Shim::GetEndpoint(i), false);
+    
+    const std::string unique = "brb-test-" + std::to_string(getpid());
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t endpoint = Shim::GetEndpoint(i);
+        devices[i].OnOpen = [endpoint](bool open) { Shim::SetEndpointPolled(endpoint, open); };
+        CHECK(devices[i].Create("Big Red Button test", unique + "/input" + std::to_string(i), unique,
+            Shim::GetReportDescriptor(Shim::GetInterface(i))));
+    }
+    Shim::SetPacketHandler([&](const Shim::Packet& packet) {
+        devices[packet.Endpoint == Shim::GetEndpoint(0) ? 0 : 1].SendInput(packet.Data);
+    });
+    emulator.SetIdleHandler([&]() {
+        for (int i = 0; i < 2; i++) devices[i].Process();
+    });
+    
+    // The kernel parses the descriptor and creates the node asynchronously
+    std::string path;
+    for (int attempt = 0; attempt < 200 && path.empty(); attempt++)
+    {
+        emulator.Run(10000);
+        usleep(10000);
+        path = findHidraw(unique, unique + "/input0");
+    }
+    CHECK(!path.empty());
+    if (path.empty()) return CHECK_RESULT();
+    
+    const int hidraw = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (hidraw < 0 && (errno == EACCES || errno == EPERM))
+    {
+        fprintf(stderr, "%s: %s, skipped\n", path.c_str(), strerror(errno));
+        return TEST_SKIPPED;
+    }
+    CHECK(hidraw >= 0);
+    if (hidraw < 0) return CHECK_RESULT();
+    
+    // Opening the node makes the host poll the endpoint
+    emulator.Run(20000);
+    std::istringstream script("press\nwait 50\nrelease\nwait 50");
+    std::string error;
+    CHECK(emulator.RunScript(script, error));
+    
+    bool pressed = false;
+    uint8_t report[64];
+    pollfd fd = { hidraw, POLLIN, 0 };
+    while (!pressed && poll(&fd, 1, 1000) > 0)
+    {
+        const ssize_t size = read(hidraw, report, sizeof(report));
+        if (size == 9 && report[0] == 0x02 && report[3] == 0x28) pressed = true;
+    }
+    CHECK(pressed);
+    
+    close(hidraw);
+    return CHECK_RESULT();
+}
@@ -0,0 +1,93 @@
+/*
+    TestVendorLatency.cpp
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Key reports under load from vendor reports: with press velocity and timestamps on and nobody
+    reading the vendor interface (its endpoint fills up), presses still reach the host within a few
+    milliseconds, and the vendor reports follow their key report once the interface is read.
+*/
+
+#include "Check.h"
+#include <VbsEmulator.h>
+#include <Shim.h>
+#include <sstream>
+#include <vector>
+#include <VbsBigRedButton.h>
+#include <VbsKeyboard.h>
+
+// The sketch's instance
+extern VbsBigRedButton BigRedButton;
+
+static std::vector<Shim::Packet> packets;
+
+// Time of the first keyboard report with the key after the given time, 0 if none
+static uint64_t keyReportTime(const uint64_t after, const uint8_t key)
+{
+    for (const Shim::Packet& packet : packets)
+    {
+        if (packet.Time >= after && packet.Endpoint == Shim::GetEndpoint(0) && packet.Data.size() == 9 && packet.Data[3] == key) return packet.Time;
+    }
+    return 0;
+}
+
+int main()
+{
+    VbsEmulator emulator;
+    Shim::SetPacketHandler([](const Shim::Packet& packet) { packets.push_back(packet); });
+    emulator.Start();
+    BigRedButton.SetPressVelocitySampling(true);
+    BigRedButton.SetPressTimestamps(true);
+    emulator.SyncClock();
+    
+    // Nobody reads the vendor interface
+    Shim::SetEndpointPolled(Shim::GetEndpoint(1), false);
+    emulator.Run(300000);
+    
+    // Program 0 holds Enter while pressed
+    uint64_t worst = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        const uint64_t press = Shim::Now();
+        emulator.SetButton(true);
+        emulator.Run(100000);
+        emulator.SetButton(false);
+        emulator.Run(100000);
+        
+        const uint64_t reported = keyReportTime(press, KEY_ENTER);
+        CHECK(reported != 0);
+        if (reported > press && reported - press > worst) worst = reported - press;
+    }
+    
+    // Transition, confirmation and the velocity burst (up to 3.8 ms), then the next frame
+    printf("worst press to key report: %llu us\n", (unsigned long long)worst);
+    CHECK(worst <= 6000);
+    CHECK(Shim::GetCounters().UsbWaits == 0);
+    
+    // Once read, the queued reports come, and every new vendor report comes after its key report
+    Shim::SetEndpointPolled(Shim::GetEndpoint(1), true);
+    emulator.Run(100000);
+    packets.clear();
+    
+    const uint64_t press = Shim::Now();
+    emulator.SetButton(true);
+    emulator.Run(100000);
+    emulator.SetButton(false);
+    emulator.Run(100000);
+    
+    const uint64_t key = keyReportTime(press, KEY_ENTER);
+    int velocity = 0;
+    int pressTime = 0;
+    for (const Shim::Packet& packet : packets)
+    {
+        if (packet.Endpoint != Shim::GetEndpoint(1) || packet.Data.size() != 9 || packet.Data[0] != HID_REPORTID_VENDOR) continue;
+        CHECK(packet.Time >= key);
+        if (packet.Data[1] == VENDOR_PRESS_VELOCITY) velocity++;
+        if (packet.Data[1] == VENDOR_PRESS_TIME) pressTime++;
+    }
+    CHECK(key != 0);
+    CHECK(velocity == 1);
+    CHECK(pressTime == 1);
+    
+    return CHECK_RESULT();
+}
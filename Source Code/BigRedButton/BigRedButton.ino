@@ -47,9 +47,33 @@ void setup()
     // This is how long the button must be held to register a long press (in milliseconds).
     BigRedButton.SetLongPressTime(700);
     
+    // Additional long press stages, measured from the press like the long press time (in milliseconds).
+    // Each stage flashes the LED, the light fades in while approaching the next one. Set to 0 to disable.
+    BigRedButton.SetLongPressStages(0, 0);
+    
     // This is the time frame under which it registers as double click (in milliseconds).
     BigRedButton.SetDoubleClickTime(400);
     
+    // Send single click right away on release instead of after the double click time. When it turns out to be
+    // a double click, UpgradedToDoubleClick fires on the second press, so the single click can be undone.
+    BigRedButton.SetSpeculativeSingleClick(false);
+    
+    // Shrink the double click time to twice the time the user actually takes between the two presses.
+    BigRedButton.SetAdaptiveDoubleClick(false);
+    
+    // Measure how hard the button is hit on every press and send it to the host as a vendor report (0-255).
+    // Samples the transition for up to 3.8 ms after the press is detected, which delays the press event as much.
+    BigRedButton.SetPressVelocitySampling(false);
+    
+    // Run the ADC at 250 kHz instead of 125 kHz, so reading the button takes 52 us instead of 104 us. This is
+    // above the 200 kHz the datasheet allows for full 10 bit accuracy, which a button can afford, but it also
+    // applies to every other analogRead() of the sketch.
+    BigRedButton.SetFastAnalogRead(false);
+    
+    // Send the time of every press on the host's clock as a vendor report, once the host synchronized the
+    // clock (see README). For telling which of several buttons was pressed first.
+    BigRedButton.SetPressTimestamps(false);
+    
     // Speed of the LED brightness transition, bigger value -> faster transition.
     BigRedButton.SetLightChangeSpeed(25.0f);
 
@@ -62,6 +86,25 @@ void setup()
     // Light pulse frequency and size (% between 0.0f and 1.0f), when LED is kept lit.
     // Set frequency to 0.0f to disable.
     BigRedButton.SetLightPulse(0.5f, 0.75f);
+    
+    // Key repeat generated by the button itself when using HoldKeyRepeat(), independent of the OS settings.
+    // Delay before the first repeat (in milliseconds) and repeats per second (up to 500).
+    Keyboard.SetAutoRepeat(500, 30);
+    
+    // Keys sent by each program (program index, gesture, key, modifiers). See the events in loop() below.
+    BigRedButton.SetKeyMapping(0, GESTURE_PRESS, KEY_ENTER);
+    BigRedButton.SetKeyMapping(1, GESTURE_PRESS, KEY_SPACE);
+    BigRedButton.SetKeyMapping(2, GESTURE_SINGLE_CLICK, KEY_F13);
+    BigRedButton.SetKeyMapping(2, GESTURE_DOUBLE_CLICK, KEY_F14);
+    BigRedButton.SetKeyMapping(2, GESTURE_LONG_PRESS, KEY_F15);
+    BigRedButton.SetKeyMapping(2, GESTURE_LONG_PRESS_DOUBLE_CLICK, KEY_F16);
+    BigRedButton.SetKeyMapping(2, GESTURE_UPGRADED_TO_DOUBLE_CLICK, KEY_F17);
+    BigRedButton.SetKeyMapping(3, GESTURE_CLICK, KEY_L, MOD_LEFT_GUI);
+    BigRedButton.SetKeyMappingPage1(3, GESTURE_LONG_PRESS, KEY1_SYSTEM_SLEEP);
+    
+    // Everything above are defaults. If the host saved a configuration into the EEPROM (through the feature
+    // report), that replaces them. Must be called last.
+    BigRedButton.LoadConfig();
 }
 
 
@@ -79,7 +122,7 @@ void loop()
         {
             auto event = BigRedButton.PollSingleButtonEvent();
             
-            if (event.Press) Keyboard.HoldKey(KEY_ENTER);
+            if (event.Press) BigRedButton.HoldMappedKey(GESTURE_PRESS);
             if (event.Release) Keyboard.ReleaseKey();
             break;
         }
@@ -87,7 +130,7 @@ void loop()
         {
             auto event = BigRedButton.PollSingleButtonEvent();
             
-            if (event.Press) Keyboard.HoldKey(KEY_SPACE);
+            if (event.Press) BigRedButton.HoldMappedKey(GESTURE_PRESS);
             if (event.Release) Keyboard.ReleaseKey();
             break;
         }
@@ -95,18 +138,23 @@ void loop()
         {
             auto event = BigRedButton.PollQuadButtonEvent();
             
-            if (event.SingleClick) Keyboard.PressKey(KEY_F13);
-            if (event.DoubleClick) Keyboard.PressKey(KEY_F14);
-            if (event.LongPress) Keyboard.PressKey(KEY_F15);
-            if (event.LongPressDoubleClick) Keyboard.PressKey(KEY_F16);
+            if (event.SingleClick) BigRedButton.PressMappedKey(GESTURE_SINGLE_CLICK);
+            if (event.DoubleClick) BigRedButton.PressMappedKey(GESTURE_DOUBLE_CLICK);
+            if (event.LongPress) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS);
+            if (event.LongPressDoubleClick) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS_DOUBLE_CLICK);
+            if (event.UpgradedToDoubleClick) BigRedButton.PressMappedKey(GESTURE_UPGRADED_TO_DOUBLE_CLICK);
+            if (event.LongPressStage == 2) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS_STAGE_2);
+            if (event.LongPressStage == 3) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS_STAGE_3);
             break;
         }
         case 3:
         {
             auto event = BigRedButton.PollDualButtonEvent();
             
-            if (event.Click) Keyboard.PressKey(KEY_L, MOD_LEFT_GUI);
-            if (event.LongPress) Keyboard.PressKeyPage1(KEY1_SYSTEM_SLEEP);
+            if (event.Click) BigRedButton.PressMappedKey(GESTURE_CLICK);
+            if (event.LongPress) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS);
+            if (event.LongPressStage == 2) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS_STAGE_2);
+            if (event.LongPressStage == 3) BigRedButton.PressMappedKey(GESTURE_LONG_PRESS_STAGE_3);
             break;
         }
     }
@@ -22,6 +22,29 @@
 */
 
 #include "VbsBigRedButton.h"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+// Button calibration
+static const int CALIBRATION_SAMPLES = 16;
+static const int NOISE_FACTOR = 2; // Thresholds are this many times the peak noise away from the levels...
+static const int MIN_MARGIN = 24;  // ...but at least this much
+static const unsigned long NOISE_DECAY_PERIOD = 16; // ms (peak noise fades by 1/64 this often, about 1 s in total)
+static const uint8_t EDGE_CONFIRM_SAMPLES = 3; // Consecutive samples past the threshold needed for an edge
+static const int MIN_DWELL_TIME = 2;
+static const int MAX_DWELL_TIME = 20;
+static const int MAX_SETTLE_TIME = 50;
+
+// Press velocity
+static const int VELOCITY_SAMPLES = 32;
+static const unsigned long VELOCITY_SAMPLE_PERIOD = 120; // us (longer than a conversion at the default ADC clock, 104 us)
+static const int VELOCITY_FULL_SCALE = 4; // Full swing within this many samples is the maximum velocity
+
+// Adaptive double click
+static const int MIN_DOUBLE_CLICK_WINDOW = 150;
+
+// Tap patterns
+static const uint8_t TAP_NODE_IGNORE = 0xFF; // Taps after a mismatch, until the next pause
 
 static int MinMax(const int min, const int max, const int value)
 {
@@ -33,6 +56,45 @@ static float MinMax(const float min, const float max, const float value)
     return value < min ? min : (value > max ? max : value);
 }
 
+// Drop between two samples scaled to one velocity sample period. Samples further apart (loop polls)
+// are scaled down, closer ones are taken as they are, so noise is never amplified.
+static int VelocityDrop(const int drop, const unsigned long elapsed)
+{
+    if (elapsed <= VELOCITY_SAMPLE_PERIOD) return drop;
+    return (int)((long)drop * (long)VELOCITY_SAMPLE_PERIOD / (long)elapsed);
+}
+
+#if defined(USBCON)
+static_assert(sizeof(VbsButtonConfig) <= FEATURE_REPORT_SIZE, "Config does not fit in the feature report");
+#endif
+
+static uint16_t ConfigCrc(const VbsButtonConfig& config)
+{
+    uint16_t crc = 0xFFFF;
+    const uint8_t* data = (const uint8_t*)&config;
+    for (uint8_t i = 0; i < sizeof(VbsButtonConfig) - sizeof(config.Crc); i++)
+    {
+        crc = _crc16_update(crc, data[i]);
+    }
+    return crc;
+}
+
+static bool IsConfigValid(const VbsButtonConfig& config)
+{
+    return config.Version == CONFIG_VERSION && config.Crc == ConfigCrc(config);
+}
+
+static void TrackLevel(int& level, int& noise, uint8_t& samples, const int value, const bool decay)
+{
+    // Moving average of the level and the peak distance from it, slowly fading (both multiplied by 16)
+    const int sample = value * 16;
+    level += (sample - level) / 16;
+    const int deviation = abs(sample - level);
+    if (deviation > noise) noise = deviation;
+    else if (decay) noise -= (noise + 63) / 64;
+    if (samples < CALIBRATION_SAMPLES) samples++;
+}
+
 VbsBigRedButton::VbsBigRedButton(const uint8_t pinButton, const uint8_t pinLight, const uint8_t pinSwitch1, const uint8_t pinSwitch2) :
     _pinButton(pinButton),
     _pinLight(pinLight),
@@ -45,20 +107,186 @@ VbsBigRedButton::VbsBigRedButton(const uint8_t pinButton, const uint8_t pinLight
     pinMode(_pinSwitch2, INPUT);
     
     // Set default values
+    memset(&_config.Keys, 0, sizeof(_config.Keys));
     digitalWrite(_pinLight, HIGH);
     resetButtonState();
     _programIndex = readProgramSwitch();
 }
 
-bool VbsBigRedButton::readButton() const
+void VbsBigRedButton::calibrateButton()
+{
+    // Burst of samples on the first read (the ADC is not running yet in the constructor),
+    // assuming nobody is holding the button at power on
+    int samples[CALIBRATION_SAMPLES];
+    long sum = 0;
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+    {
+        samples[i] = analogRead(_pinButton);
+        sum += samples[i];
+    }
+    const int level = sum / CALIBRATION_SAMPLES;
+    
+    int deviation = 0;
+    for (int i = 0; i < CALIBRATION_SAMPLES; i++)
+    {
+        deviation = max(deviation, abs(samples[i] - level));
+    }
+    
+    // If it is held, start from the closed state instead
+    if (level >= 512)
+    {
+        _adcOpenLevel = level * 16;
+        _adcOpenNoise = deviation * 16;
+        _adcOpenSamples = CALIBRATION_SAMPLES;
+    }
+    else
+    {
+        _adcClosedLevel = level * 16;
+        _adcClosedNoise = deviation * 16;
+        _adcClosedSamples = CALIBRATION_SAMPLES;
+    }
+    updateThresholds();
+}
+
+void VbsBigRedButton::updateThresholds()
+{
+    const int openLevel = _adcOpenLevel / 16;
+    const int closedLevel = _adcClosedLevel / 16;
+    const int middle = (openLevel + closedLevel) / 2;
+    
+    // Fire as soon as the signal is clearly out of the noise of the current state, but never past the middle.
+    // Until a level is measured, stay at the middle like a plain Schmitt trigger.
+    const int openMargin = max(MIN_MARGIN, _adcOpenNoise * NOISE_FACTOR / 16);
+    const int closedMargin = max(MIN_MARGIN, _adcClosedNoise * NOISE_FACTOR / 16);
+    _pressThreshold = _adcOpenSamples < CALIBRATION_SAMPLES ? middle : max(middle, openLevel - openMargin);
+    _releaseThreshold = _adcClosedSamples < CALIBRATION_SAMPLES ? middle : min(middle, closedLevel + closedMargin);
+}
+
+void VbsBigRedButton::measurePressVelocity()
+{
+    // The trajectory started with the last sample before the press and went on through the samples that
+    // confirmed it (see readButton()), a fast press is already at the closed level by now. If it is not,
+    // the rest of the transition is followed at a fixed sample rate. The steepest drop per sample period
+    // tells how hard the button was hit.
+    int lastValue = _lastSampleValue;
+    unsigned long lastMicros = _lastSampleMicros;
+    int maxDrop = _pressMaxDrop;
+    unsigned long sampleTime = lastMicros;
+    for (int i = 0; i < VELOCITY_SAMPLES && lastValue >= _releaseThreshold; i++)
+    {
+        sampleTime += VELOCITY_SAMPLE_PERIOD;
+        while ((long)(micros() - sampleTime) < 0);
+        const unsigned long sampleMicros = micros();
+        const int value = analogRead(_pinButton);
+        maxDrop = max(maxDrop, VelocityDrop(lastValue - value, sampleMicros - lastMicros));
+        lastValue = value;
+        lastMicros = sampleMicros;
+    }
+    
+    const long span = max(1, (_adcOpenLevel - _adcClosedLevel) / 16);
+    _pressVelocity = MinMax(1, 255, (int)(maxDrop * 255L * VELOCITY_FULL_SCALE / span));
+    _pressVelocityPending = true;
+}
+
+void VbsBigRedButton::sendPendingReports()
+{
+#if defined(USBCON)
+    // Vendor reports of the last press go out on the next poll, after the key report the sketch sent for it
+    // (the sync is checked on every poll, so a stale one is dropped before micros() wraps around)
+    const bool synced = _pressTimestampsEnabled && Keyboard.IsClockSynced();
+    if (_pressTimePending && synced)
+    {
+        // Press time on the host clock, so the host can tell which of several buttons was pressed first
+        const uint32_t hostTime = Keyboard.GetHostTime(_pressMicros);
+        Keyboard.SendVendorReport(VENDOR_PRESS_TIME, &hostTime, sizeof(hostTime));
+    }
+    if (_pressVelocityPending)
+    {
+        Keyboard.SendVendorReport(VENDOR_PRESS_VELOCITY, &_pressVelocity, 1);
+    }
+    Keyboard.FlushVendorReports();
+#endif
+    _pressTimePending = false;
+    _pressVelocityPending = false;
+}
+
+bool VbsBigRedButton::readButton()
 {
+    if (_adcOpenSamples == 0 && _adcClosedSamples == 0)
+    {
+        calibrateButton();
+    }
+    
     // (Note that the value is inverse because of the pull-up resistor)
-    int value = analogRead(_pinButton);
+    const unsigned long sampleMicros = micros();
+    const int value = analogRead(_pinButton);
+    const unsigned long timestamp = millis();
+    const int previousValue = _lastSampleValue;
+    const unsigned long previousMicros = _lastSampleMicros;
+    _lastSampleValue = value;
+    _lastSampleMicros = sampleMicros;
+    const unsigned long sinceEdge = timestamp - _buttonEdgeTime;
+    
+    // The thresholds are close to the levels, so the opposite edge is only allowed once the signal
+    // has arrived to the new level (or it took too long) and has been there for the dwell time
+    if (!_buttonSettled)
+    {
+        const bool arrived = _buttonLastState ? value < _releaseThreshold : value >= _pressThreshold;
+        if (!arrived && sinceEdge < (unsigned long)MAX_SETTLE_TIME) return _buttonLastState;
+        
+        // Dwell time follows twice the time it takes to settle
+        _buttonSettled = true;
+        _dwellTime = MinMax(MIN_DWELL_TIME, MAX_DWELL_TIME, (int)((_dwellTime * 3 + sinceEdge * 2) / 4));
+    }
+    if (sinceEdge < (unsigned long)_dwellTime) return _buttonLastState;
     
     // Schmitt trigger
-    if (_buttonLastState && value >= 768) return false;
-    if (!_buttonLastState && value < 256) return true;
-    return _buttonLastState;
+    bool state = _buttonLastState;
+    if (_buttonLastState && value >= _releaseThreshold) state = false;
+    if (!_buttonLastState && value < _pressThreshold) state = true;
+    
+    if (state != _buttonLastState)
+    {
+        // A single sample past the threshold can be a spike, the edge only counts if the signal stays there.
+        // The samples of a press are part of its velocity trajectory, a slam can be over by the time it counts.
+        if (_edgeSamples == 0)
+        {
+            _edgeMicros = sampleMicros;
+            _pressMaxDrop = 0;
+        }
+        if (state) _pressMaxDrop = max(_pressMaxDrop, VelocityDrop(previousValue - value, sampleMicros - previousMicros));
+        if (++_edgeSamples < EDGE_CONFIRM_SAMPLES) return _buttonLastState;
+        _edgeSamples = 0;
+        
+        _buttonEdgeTime = timestamp;
+        _buttonSettled = false;
+        
+        if (state && _pressTimestampsEnabled)
+        {
+            _pressMicros = _edgeMicros;
+            _pressTimePending = true;
+        }
+        if (state && _pressVelocityEnabled)
+        {
+            measurePressVelocity();
+        }
+        return state;
+    }
+    
+    // Stable, keep tracking the level of the current state
+    _edgeSamples = 0;
+    const bool decay = timestamp - _noiseDecayTime >= NOISE_DECAY_PERIOD;
+    if (decay) _noiseDecayTime = timestamp;
+    if (state)
+    {
+        TrackLevel(_adcClosedLevel, _adcClosedNoise, _adcClosedSamples, value, decay);
+    }
+    else
+    {
+        TrackLevel(_adcOpenLevel, _adcOpenNoise, _adcOpenSamples, value, decay);
+    }
+    updateThresholds();
+    return state;
 }
 
 int VbsBigRedButton::readProgramSwitch() const
@@ -72,17 +300,23 @@ int VbsBigRedButton::readProgramSwitch() const
 void VbsBigRedButton::resetButtonState()
 {
     _buttonLastState = false;
+    _buttonSettled = true;
+    _buttonEdgeTime = 0;
+    _edgeSamples = 0;
     _longPressStarted = 0;
     _doubleClickStarted = 0;
     _doubleClickInProgress = false;
     _nextReleaseIsDoubleClick = false;
     _longPressFired = false;
+    _singleClickSent = false;
+    _tapNode = 0;
+    _tapClassified = false;
     
     _lightOverride = LIGHT_FREE;
     _lightFeedbackFlashRunning = false;
 }
 
-void VbsBigRedButton::updateLight()
+void VbsBigRedButton::updateLight(const float pressedBrightness)
 {
     // Calculate delta time
     const unsigned long timestamp = millis();
@@ -90,7 +324,7 @@ void VbsBigRedButton::updateLight()
     
     if (delta_i > 0)
     {
-        const float delta = delta_i / 1000.0f;
+        const float delta = delta_i * 0.001f;
         _lastTimestamp = timestamp;
         
         // Update feedback flashing
@@ -121,14 +355,16 @@ void VbsBigRedButton::updateLight()
         {
             if (_buttonLastState)
             {
-                newBrightness = 1.0f;
+                newBrightness = pressedBrightness;
             }
             else if (_lightKeepLit)
             {
                 if (_lightPulseEnabled)
                 {
-                    _lightPulseTime = fmod(_lightPulseTime + delta, 1.0f / _lightPulseFreq);
-                    const float pulseBrightness = sin(_lightPulseTime * _lightPulseFreq * PI * 2.0f) * 0.5f + 0.5f;
+                    // (Phase is kept between 0 and 1, cheaper than fmod() on the AVR)
+                    _lightPulsePhase += delta * _lightPulseFreq;
+                    while (_lightPulsePhase >= 1.0f) _lightPulsePhase -= 1.0f;
+                    const float pulseBrightness = sin(_lightPulsePhase * PI * 2.0f) * 0.5f + 0.5f;
                     newBrightness = pulseBrightness * _lightPulseSize + (1.0f - _lightPulseSize);
                 }
                 else
@@ -142,7 +378,12 @@ void VbsBigRedButton::updateLight()
         const float changeRatio = MinMax(0.0f, 1.0f, delta * _lightChangeSpeed);
         _lightBrightness = (changeRatio * newBrightness) + ((1.0f - changeRatio) * _lightBrightness);
 
-        analogWrite(_pinLight, 255 - (int)(_lightBrightness * _lightMaxBrightness * 255.0f));
+        const uint8_t lightPwm = 255 - (int)(_lightBrightness * _lightMaxBrightness * 255.0f);
+        if (lightPwm != _lightPwm)
+        {
+            _lightPwm = lightPwm;
+            analogWrite(_pinLight, lightPwm);
+        }
     }
 }
 
@@ -155,11 +396,129 @@ void VbsBigRedButton::triggerFeedbackFlash()
 void VbsBigRedButton::SetLongPressTime(const int ms)
 {
     _longPressTime = MinMax(1, 10000, ms);
+    updateLongPressStages();
+}
+
+void VbsBigRedButton::updateDoubleClickWindow()
+{
+    // Twice the usual time between the presses, but never longer than configured
+    _doubleClickWindow = _adaptiveDoubleClick
+        ? MinMax(min(MIN_DOUBLE_CLICK_WINDOW, _doubleClickTime), _doubleClickTime, _doubleClickLearned * 2)
+        : _doubleClickTime;
+}
+
+void VbsBigRedButton::SetLongPressStages(const int stage2, const int stage3)
+{
+    _longPressStage2Time = stage2 > 0 ? MinMax(1, 30000, stage2) : 0;
+    _longPressStage3Time = stage3 > 0 ? MinMax(1, 30000, stage3) : 0;
+    updateLongPressStages();
+}
+
+void VbsBigRedButton::updateLongPressStages()
+{
+    // Stages only count while each is later than the one before
+    _longPressStageTimes[0] = _longPressTime;
+    _longPressStageTimes[1] = _longPressStage2Time;
+    _longPressStageTimes[2] = _longPressStage3Time;
+    
+    _longPressStageCount = 1;
+    while (_longPressStageCount < LONG_PRESS_STAGES &&
+        _longPressStageTimes[_longPressStageCount] > _longPressStageTimes[_longPressStageCount - 1])
+    {
+        _longPressStageCount++;
+    }
+}
+
+void VbsBigRedButton::startLongPress(const unsigned long timestamp)
+{
+    // Deadlines of all stages are calculated once here, polling only looks at the next one
+    _longPressStarted = timestamp;
+    _longPressFired = false;
+    _longPressStage = 0;
+    for (uint8_t i = 0; i < _longPressStageCount; i++)
+    {
+        _longPressDeadlines[i] = timestamp + _longPressStageTimes[i];
+    }
+}
+
+uint8_t VbsBigRedButton::pollLongPressStage(const bool buttonState, const unsigned long timestamp)
+{
+    if (!buttonState || _longPressStage >= _longPressStageCount) return 0;
+    if ((long)(timestamp - _longPressDeadlines[_longPressStage]) <= 0) return 0;
+    
+    _longPressFired = true;
+    return ++_longPressStage;
+}
+
+int VbsBigRedButton::longPressProgress(const unsigned long timestamp) const
+{
+    if (!_buttonLastState) return 0;
+    if (_longPressStage >= _longPressStageCount) return 100;
+    
+    const unsigned long from = _longPressStage == 0 ? _longPressStarted : _longPressDeadlines[_longPressStage - 1];
+    const unsigned long length = _longPressDeadlines[_longPressStage] - from;
+    return MinMax(0, 100, (int)((timestamp - from) * 100 / length));
+}
+
+float VbsBigRedButton::longPressBrightness(const unsigned long timestamp) const
+{
+    // With multiple stages the light ramps up towards each stage, otherwise it is simply lit while pressed
+    if (_longPressStageCount < 2) return 1.0f;
+    return 0.2f + longPressProgress(timestamp) * 0.008f;
+}
+
+int VbsBigRedButton::GetLongPressProgress() const
+{
+    return longPressProgress(millis());
 }
 
 void VbsBigRedButton::SetDoubleClickTime(const int ms)
 {
     _doubleClickTime = MinMax(1, 10000, ms);
+    _doubleClickLearned = _doubleClickTime / 2;
+    updateDoubleClickWindow();
+}
+
+void VbsBigRedButton::SetSpeculativeSingleClick(const bool enabled)
+{
+    _speculativeSingleClick = enabled;
+}
+
+void VbsBigRedButton::SetAdaptiveDoubleClick(const bool enabled)
+{
+    _adaptiveDoubleClick = enabled;
+    _doubleClickLearned = _doubleClickTime / 2;
+    updateDoubleClickWindow();
+}
+
+void VbsBigRedButton::SetPressVelocitySampling(const bool enabled)
+{
+    _pressVelocityEnabled = enabled;
+}
+
+void VbsBigRedButton::SetFastAnalogRead(const bool enabled)
+{
+    // ADC clock 250 kHz (prescaler 64) or the default 125 kHz (prescaler 128). The datasheet only promises
+    // full 10 bit resolution up to 200 kHz, the faster clock costs a bit or two of noise on every analog pin.
+    const uint8_t prescaler = enabled ? (1 << ADPS2) | (1 << ADPS1) : (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    ADCSRA = (ADCSRA & ~((1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0))) | prescaler;
+}
+
+void VbsBigRedButton::SetPressTimestamps(const bool enabled)
+{
+    _pressTimestampsEnabled = enabled;
+}
+
+void VbsBigRedButton::SetTapPatterns(const VbsTapNode* nodes)
+{
+    _tapNodes = nodes;
+    _tapNode = 0;
+}
+
+void VbsBigRedButton::SetTapTiming(const int longTime, const int pauseTime)
+{
+    _tapLongTime = MinMax(1, 10000, longTime);
+    _tapPauseTime = MinMax(1, 10000, pauseTime);
 }
 
 void VbsBigRedButton::SetLightChangeSpeed(const float speed)
@@ -184,6 +543,150 @@ void VbsBigRedButton::SetLightPulse(const float frequency, const float size)
     _lightPulseSize = MinMax(0.01f, 1.0f, size);
 }
 
+VbsButtonCalibration VbsBigRedButton::GetCalibration() const
+{
+    VbsButtonCalibration calibration;
+    calibration.OpenLevel = _adcOpenLevel / 16;
+    calibration.OpenNoise = _adcOpenNoise / 16;
+    calibration.ClosedLevel = _adcClosedLevel / 16;
+    calibration.ClosedNoise = _adcClosedNoise / 16;
+    calibration.PressThreshold = _pressThreshold;
+    calibration.ReleaseThreshold = _releaseThreshold;
+    calibration.DwellTime = _dwellTime;
+    return calibration;
+}
+
+void VbsBigRedButton::SetKeyMapping(const int program, const int gesture, const uint8_t key, const uint8_t modifier)
+{
+    if (program < 0 || program >= PROGRAM_COUNT || gesture < 0 || gesture >= GESTURE_COUNT) return;
+    
+    VbsKeyMapping& mapping = _config.Keys[program][gesture];
+    mapping.Page = KEYMAP_PAGE7;
+    mapping.Modifier = modifier;
+    mapping.Key = key;
+}
+
+void VbsBigRedButton::SetKeyMappingPage1(const int program, const int gesture, const uint16_t key)
+{
+    if (program < 0 || program >= PROGRAM_COUNT || gesture < 0 || gesture >= GESTURE_COUNT) return;
+    
+    VbsKeyMapping& mapping = _config.Keys[program][gesture];
+    mapping.Page = KEYMAP_PAGE1;
+    mapping.Modifier = 0;
+    mapping.Key = key;
+}
+
+void VbsBigRedButton::captureConfig()
+{
+    VbsButtonConfig config = _config;
+    config.Version = CONFIG_VERSION;
+    config.LongPressTime = _longPressTime;
+    config.LongPressStage2Time = _longPressStage2Time;
+    config.LongPressStage3Time = _longPressStage3Time;
+    config.DoubleClickTime = _doubleClickTime;
+    config.LightFeedbackFlashSpeed = _lightFeedbackFlashSpeed;
+    config.LightChangeSpeed = _lightChangeSpeed;
+    config.LightMaxBrightness = _lightMaxBrightness;
+    config.LightPulseFrequency = _lightPulseEnabled ? _lightPulseFreq : 0.0f;
+    config.LightPulseSize = _lightPulseSize;
+    config.Flags =
+        (_speculativeSingleClick ? CONFIG_SPECULATIVE_SINGLE_CLICK : 0) |
+        (_adaptiveDoubleClick ? CONFIG_ADAPTIVE_DOUBLE_CLICK : 0) |
+        (_pressVelocityEnabled ? CONFIG_PRESS_VELOCITY_SAMPLING : 0) |
+        (_pressTimestampsEnabled ? CONFIG_PRESS_TIMESTAMPS : 0);
+    config.Crc = ConfigCrc(config);
+    
+    // The host can read it from the USB interrupt any time
+    noInterrupts();
+    _config = config;
+    interrupts();
+}
+
+void VbsBigRedButton::applyConfig(const VbsButtonConfig& config)
+{
+    SetLongPressTime(config.LongPressTime);
+    SetLongPressStages(config.LongPressStage2Time, config.LongPressStage3Time);
+    SetDoubleClickTime(config.DoubleClickTime);
+    SetLightFeedbackFlashSpeed(config.LightFeedbackFlashSpeed);
+    SetLightChangeSpeed(config.LightChangeSpeed);
+    SetLightMaxBrightness(config.LightMaxBrightness);
+    SetLightPulse(config.LightPulseFrequency, config.LightPulseSize);
+    SetSpeculativeSingleClick(config.Flags & CONFIG_SPECULATIVE_SINGLE_CLICK);
+    SetAdaptiveDoubleClick(config.Flags & CONFIG_ADAPTIVE_DOUBLE_CLICK);
+    SetPressVelocitySampling(config.Flags & CONFIG_PRESS_VELOCITY_SAMPLING);
+    SetPressTimestamps(config.Flags & CONFIG_PRESS_TIMESTAMPS);
+    memcpy(&_config.Keys, &config.Keys, sizeof(_config.Keys));
+    
+    // Store the values as they were actually applied
+    captureConfig();
+}
+
+bool VbsBigRedButton::LoadConfig()
+{
+    // Anything in the EEPROM that is not a valid config of this version is ignored, and the defaults stay
+    VbsButtonConfig config;
+    eeprom_read_block(&config, (const void*)CONFIG_EEPROM_ADDRESS, sizeof(VbsButtonConfig));
+    
+    const bool valid = IsConfigValid(config);
+    if (valid)
+    {
+        applyConfig(config);
+    }
+    else
+    {
+        captureConfig();
+    }
+    
+#if defined(USBCON)
+    Keyboard.SetFeatureReport(&_config, sizeof(VbsButtonConfig));
+#endif
+    return valid;
+}
+
+void VbsBigRedButton::updateConfig()
+{
+#if defined(USBCON)
+    // New config from the host, applied here so a poll always runs with one consistent config
+    VbsButtonConfig config;
+    if (Keyboard.ReadFeatureReport(&config, sizeof(VbsButtonConfig)) && IsConfigValid(config))
+    {
+        applyConfig(config);
+        _eepromWritePosition = 0;
+    }
+#endif
+    
+    // Save it one byte per poll, only when the EEPROM is not busy, so polling never waits for it
+    // (the CRC is written last, an interrupted save falls back to the defaults)
+    if (_eepromWritePosition < sizeof(VbsButtonConfig) && eeprom_is_ready())
+    {
+        eeprom_update_byte((uint8_t*)CONFIG_EEPROM_ADDRESS + _eepromWritePosition, ((const uint8_t*)&_config)[_eepromWritePosition]);
+        _eepromWritePosition++;
+    }
+}
+
+void VbsBigRedButton::PressMappedKey(const int gesture)
+{
+#if defined(USBCON)
+    if (gesture < 0 || gesture >= GESTURE_COUNT) return;
+    
+    const VbsKeyMapping& mapping = _config.Keys[_programIndex][gesture];
+    if (mapping.Page == KEYMAP_PAGE7) Keyboard.PressKey(mapping.Key, mapping.Modifier);
+    if (mapping.Page == KEYMAP_PAGE1) Keyboard.PressKeyPage1(mapping.Key);
+#endif
+}
+
+void VbsBigRedButton::HoldMappedKey(const int gesture)
+{
+#if defined(USBCON)
+    if (gesture < 0 || gesture >= GESTURE_COUNT) return;
+    
+    // (Page 0x01 keys can not be held)
+    const VbsKeyMapping& mapping = _config.Keys[_programIndex][gesture];
+    if (mapping.Page == KEYMAP_PAGE7) Keyboard.HoldKeyRepeat(mapping.Key, mapping.Modifier);
+    if (mapping.Page == KEYMAP_PAGE1) Keyboard.PressKeyPage1(mapping.Key);
+#endif
+}
+
 int VbsBigRedButton::GetProgramIndex()
 {
     const int newProgramIndex = readProgramSwitch();
@@ -193,7 +696,9 @@ int VbsBigRedButton::GetProgramIndex()
         resetButtonState();
         
         // Avoid any keys getting stuck while changing program
+#if defined(USBCON)
         Keyboard.ReleaseKey();
+#endif
     }
     return _programIndex;
 }
@@ -202,7 +707,7 @@ void VbsBigRedButton::KeepLightLit(const bool lit)
 {
     if (_lightKeepLit != lit)
     {
-        _lightPulseTime = 0.0f;
+        _lightPulsePhase = 0.0f;
     }
     _lightKeepLit = lit;
 }
@@ -210,6 +715,9 @@ void VbsBigRedButton::KeepLightLit(const bool lit)
 VbsSingleButtonEvent VbsBigRedButton::PollSingleButtonEvent()
 {
     VbsSingleButtonEvent event;
+    sendPendingReports();
+    updateConfig();
+    
     const bool buttonState = readButton();
     
     // Normal button press and release, both fired once
@@ -224,6 +732,9 @@ VbsSingleButtonEvent VbsBigRedButton::PollSingleButtonEvent()
 VbsDualButtonEvent VbsBigRedButton::PollDualButtonEvent()
 {
     VbsDualButtonEvent event;
+    sendPendingReports();
+    updateConfig();
+    
     const unsigned long timestamp = millis();
     const bool buttonState = readButton();
     
@@ -235,8 +746,7 @@ VbsDualButtonEvent VbsBigRedButton::PollDualButtonEvent()
     // Button holding started
     if (buttonPressed)
     {
-        _longPressStarted = timestamp;
-        _longPressFired = false;
+        startLongPress(timestamp);
     }
     
     // Short release event, only if released before long press
@@ -246,22 +756,25 @@ VbsDualButtonEvent VbsBigRedButton::PollDualButtonEvent()
         triggerFeedbackFlash();
     }
     
-    // Long press event, fires once while pressed if button is held for some time
+    // Long press event, fires once for each stage while pressed if button is held for some time
     // (release will not trigger short release event if long press has fired)
-    event.LongPress = !_longPressFired && buttonState && _longPressStarted + _longPressTime < timestamp;
-    if (event.LongPress)
+    event.LongPressStage = pollLongPressStage(buttonState, timestamp);
+    event.LongPress = event.LongPressStage == 1;
+    if (event.LongPressStage)
     {
-        _longPressFired = true;
         triggerFeedbackFlash();
     }
     
-    updateLight();
+    updateLight(longPressBrightness(timestamp));
     return event;
 }
 
 VbsQuadButtonEvent VbsBigRedButton::PollQuadButtonEvent()
 {
     VbsQuadButtonEvent event;
+    sendPendingReports();
+    updateConfig();
+    
     const unsigned long timestamp = millis();
     const bool buttonState = readButton();
     
@@ -273,20 +786,23 @@ VbsQuadButtonEvent VbsBigRedButton::PollQuadButtonEvent()
     // Button holding started
     if (buttonPressed)
     {
-        _longPressStarted = timestamp;
-        _longPressFired = false;
+        startLongPress(timestamp);
     }
     
-    // Long press event, fires once while pressed if button is held for some time
+    // Long press event, fires once for each stage while pressed if button is held for some time
     // (release will not trigger short release event if long press has fired)
-    event.LongPress = !_longPressFired && buttonState && _longPressStarted + _longPressTime < timestamp;
+    event.LongPressStage = pollLongPressStage(buttonState, timestamp);
+    event.LongPress = event.LongPressStage == 1;
     event.LongPressDoubleClick = false;
     
+    if (event.LongPressStage)
+    {
+        triggerFeedbackFlash();
+    }
+    
     if (event.LongPress)
     {
-        _longPressFired = true;
         _doubleClickInProgress = false;
-        triggerFeedbackFlash();
         
         if (_nextReleaseIsDoubleClick)
         {
@@ -298,9 +814,10 @@ VbsQuadButtonEvent VbsBigRedButton::PollQuadButtonEvent()
     // Single/double click
     event.SingleClick = false;
     event.DoubleClick = false;
+    event.UpgradedToDoubleClick = false;
     
     const unsigned long doubleClickDelta = timestamp - _doubleClickStarted;
-    const bool withinDoubleClickTime = doubleClickDelta <= _doubleClickTime;
+    const bool withinDoubleClickTime = doubleClickDelta <= (unsigned long)_doubleClickWindow;
 
     if (_doubleClickInProgress)
     {
@@ -310,17 +827,35 @@ VbsQuadButtonEvent VbsBigRedButton::PollQuadButtonEvent()
             {
                 // Mark double click
                 _nextReleaseIsDoubleClick = true;
+                
+                // Let the single click already sent be replaced
+                event.UpgradedToDoubleClick = _singleClickSent;
+                
+                // Learn how fast the user double clicks
+                _doubleClickLearned = (_doubleClickLearned * 3 + (int)doubleClickDelta) / 4;
+                updateDoubleClickWindow();
+            }
+            else if (buttonReleased && _speculativeSingleClick && !_nextReleaseIsDoubleClick && !_singleClickSent)
+            {
+                // Speculative single click, sent right away instead of waiting for the double click time
+                event.SingleClick = true;
+                _singleClickSent = true;
+                
+                if (_lightKeepLit)
+                {
+                    triggerFeedbackFlash();
+                }
             }
         }
         else
         {
             if (!buttonState && !_nextReleaseIsDoubleClick)
             {
-                // Single click
-                event.SingleClick = true;
+                // Single click (unless already sent speculatively)
+                event.SingleClick = !_singleClickSent;
                 _doubleClickInProgress = false;
                 
-                if (_lightKeepLit)
+                if (event.SingleClick && _lightKeepLit)
                 {
                     triggerFeedbackFlash();
                 }
@@ -334,6 +869,7 @@ VbsQuadButtonEvent VbsBigRedButton::PollQuadButtonEvent()
             _doubleClickStarted = timestamp;
             _doubleClickInProgress = true;
             _nextReleaseIsDoubleClick = false;
+            _singleClickSent = false;
         }
     }
 
@@ -349,6 +885,91 @@ VbsQuadButtonEvent VbsBigRedButton::PollQuadButtonEvent()
         }
     }
     
+    updateLight(longPressBrightness(timestamp));
+    return event;
+}
+
+void VbsBigRedButton::stepTapPattern(const bool isLong, VbsTapButtonEvent& event)
+{
+    if (_tapNode == TAP_NODE_IGNORE) return;
+    
+    // One step down the trie for every tap
+    const VbsTapNode* node = &_tapNodes[_tapNode];
+    const uint8_t next = pgm_read_byte(isLong ? &node->Long : &node->Short);
+    if (next == 0)
+    {
+        event.Mismatch = true;
+        _tapNode = TAP_NODE_IGNORE;
+        return;
+    }
+    
+    // Nothing longer starts with these taps, so there is no need to wait for the pause
+    node = &_tapNodes[next];
+    if (pgm_read_byte(&node->Short) == 0 && pgm_read_byte(&node->Long) == 0)
+    {
+        event.Pattern = pgm_read_byte(&node->Pattern);
+        event.Mismatch = event.Pattern == 0;
+        _tapNode = 0;
+        return;
+    }
+    _tapNode = next;
+}
+
+VbsTapButtonEvent VbsBigRedButton::PollTapButtonEvent()
+{
+    VbsTapButtonEvent event;
+    sendPendingReports();
+    updateConfig();
+    
+    const unsigned long timestamp = millis();
+    const bool buttonState = readButton();
+    
+    // Normal button press and release, both fired once
+    event.Press = buttonState && buttonState != _buttonLastState;
+    event.Release = !buttonState && buttonState != _buttonLastState;
+    event.Pattern = 0;
+    event.Mismatch = false;
+    _buttonLastState = buttonState;
+    
+    if (_tapNodes != NULL)
+    {
+        if (event.Press)
+        {
+            _tapEdgeTime = timestamp;
+            _tapClassified = false;
+        }
+        
+        // Long tap as soon as it is held long enough, without waiting for the release
+        if (buttonState && !_tapClassified && timestamp - _tapEdgeTime >= (unsigned long)_tapLongTime)
+        {
+            _tapClassified = true;
+            stepTapPattern(true, event);
+        }
+        
+        // Short tap on release
+        if (event.Release)
+        {
+            if (!_tapClassified) stepTapPattern(false, event);
+            _tapEdgeTime = timestamp;
+        }
+        
+        // No more taps, the pattern ends here (if there is one ending here)
+        if (!buttonState && _tapNode != 0 && timestamp - _tapEdgeTime >= (unsigned long)_tapPauseTime)
+        {
+            if (_tapNode != TAP_NODE_IGNORE)
+            {
+                event.Pattern = pgm_read_byte(&_tapNodes[_tapNode].Pattern);
+                event.Mismatch = event.Pattern == 0;
+            }
+            _tapNode = 0;
+        }
+        
+        if (event.Pattern)
+        {
+            triggerFeedbackFlash();
+        }
+    }
+    
     updateLight();
     return event;
-}
\ No newline at end of file
+}
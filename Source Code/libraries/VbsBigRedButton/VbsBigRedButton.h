@@ -37,6 +37,7 @@ struct VbsDualButtonEvent
 {
     bool Click;
     bool LongPress;
+    uint8_t LongPressStage; // (1 when LongPress fires, 2 and 3 for the later stages, 0 otherwise)
 };
 
 struct VbsQuadButtonEvent
@@ -45,8 +46,89 @@ struct VbsQuadButtonEvent
     bool DoubleClick;
     bool LongPress;
     bool LongPressDoubleClick;
+    bool UpgradedToDoubleClick; // (only after a speculative single click, see SetSpeculativeSingleClick)
+    uint8_t LongPressStage; // (1 when LongPress or LongPressDoubleClick fires, 2 and 3 for the later stages, 0 otherwise)
 };
 
+struct VbsTapButtonEvent
+{
+    bool Press;
+    bool Release;
+    uint8_t Pattern; // (number of the recognized tap pattern, 0 otherwise)
+    bool Mismatch; // (the taps so far do not match any pattern, the rest is ignored until a pause)
+};
+
+// Node of a tap pattern trie, an array in PROGMEM with the root as the first node (see TapPatterns example)
+struct VbsTapNode
+{
+    uint8_t Short; // Index of the next node after a short press (0 = no pattern continues this way)
+    uint8_t Long; // Index of the next node after a long press
+    uint8_t Pattern; // Pattern number recognized when the taps end here (0 = none)
+};
+
+struct VbsButtonCalibration
+{
+    int OpenLevel;
+    int OpenNoise;
+    int ClosedLevel;
+    int ClosedNoise;
+    int PressThreshold;
+    int ReleaseThreshold;
+    int DwellTime;
+};
+
+// Key mapping slots of a program, one for each event
+#define GESTURE_PRESS                       0 // PollSingleButtonEvent()
+#define GESTURE_CLICK                       0 // PollDualButtonEvent()
+#define GESTURE_SINGLE_CLICK                0 // PollQuadButtonEvent()
+#define GESTURE_LONG_PRESS                  1
+#define GESTURE_DOUBLE_CLICK                2
+#define GESTURE_LONG_PRESS_DOUBLE_CLICK     3
+#define GESTURE_UPGRADED_TO_DOUBLE_CLICK    4
+#define GESTURE_LONG_PRESS_STAGE_2          5
+#define GESTURE_LONG_PRESS_STAGE_3          6
+#define GESTURE_COUNT                       7
+#define PROGRAM_COUNT                       4
+
+#define KEYMAP_NONE     0
+#define KEYMAP_PAGE1    1
+#define KEYMAP_PAGE7    7
+
+struct VbsKeyMapping
+{
+    uint8_t Page;
+    uint8_t Modifier;
+    uint16_t Key;
+} __attribute__((packed));
+
+// Configuration block, stored in the EEPROM and exchanged with the host in the feature report
+#define CONFIG_VERSION          2
+#define CONFIG_EEPROM_ADDRESS   0
+
+#define CONFIG_SPECULATIVE_SINGLE_CLICK     0x01
+#define CONFIG_ADAPTIVE_DOUBLE_CLICK        0x02
+#define CONFIG_PRESS_VELOCITY_SAMPLING      0x04
+#define CONFIG_PRESS_TIMESTAMPS             0x08
+
+struct VbsButtonConfig
+{
+    uint8_t Version;
+    uint16_t LongPressTime;
+    uint16_t LongPressStage2Time;
+    uint16_t LongPressStage3Time;
+    uint16_t DoubleClickTime;
+    uint16_t LightFeedbackFlashSpeed;
+    float LightChangeSpeed;
+    float LightMaxBrightness;
+    float LightPulseFrequency;
+    float LightPulseSize;
+    uint8_t Flags;
+    VbsKeyMapping Keys[PROGRAM_COUNT][GESTURE_COUNT];
+    uint16_t Crc; // CRC-16 (polynomial 0xA001, initial value 0xFFFF) of everything above
+} __attribute__((packed));
+
+#define LONG_PRESS_STAGES 3
+
 class VbsBigRedButton
 {
 private:
@@ -65,7 +147,14 @@ private:
     
     // CONFIG
     int _longPressTime = 700;
+    int _longPressStage2Time = 0;
+    int _longPressStage3Time = 0;
     int _doubleClickTime = 400;
+    bool _speculativeSingleClick = false;
+    bool _adaptiveDoubleClick = false;
+    bool _pressVelocityEnabled = false;
+    bool _pressTimestampsEnabled = false;
+    VbsButtonConfig _config; // (key mappings are only stored here)
     float _lightChangeSpeed = 25.0f; // (bigger value -> faster transition)
     int _lightFeedbackFlashSpeed = 150;
     float _lightMaxBrightness = 1.0f;
@@ -73,48 +162,125 @@ private:
     float _lightPulseFreq = 0.5f; // Hz
     float _lightPulseSize = 0.1; // %
     
+    // CALIBRATION (ADC levels and peak noise are stored multiplied by 16)
+    int _adcOpenLevel = 1023 * 16;
+    int _adcOpenNoise = 0;
+    uint8_t _adcOpenSamples = 0;
+    int _adcClosedLevel = 0;
+    int _adcClosedNoise = 0;
+    uint8_t _adcClosedSamples = 0;
+    int _pressThreshold = 512;
+    int _releaseThreshold = 512;
+    int _dwellTime = 5; // ms
+    
     // STATE
     int _programIndex;
     
     bool _buttonLastState;
+    bool _buttonSettled;
+    unsigned long _buttonEdgeTime;
+    uint8_t _edgeSamples; // (samples past the threshold so far, before the edge counts)
+    unsigned long _edgeMicros; // (time of the first of those)
+    int _lastSampleValue = 0; // (previous sample of the button, where a press trajectory starts)
+    unsigned long _lastSampleMicros = 0;
+    int _pressMaxDrop = 0; // (steepest drop per velocity sample period so far in the press trajectory)
+    unsigned long _noiseDecayTime = 0;
+    uint8_t _pressVelocity = 0;
+    bool _pressVelocityPending = false;
+    bool _pressTimePending = false;
+    unsigned long _pressMicros = 0;
     unsigned long _longPressStarted;
+    int _longPressStageTimes[LONG_PRESS_STAGES] = { 700, 0, 0 };
+    uint8_t _longPressStageCount = 1;
+    unsigned long _longPressDeadlines[LONG_PRESS_STAGES];
+    uint8_t _longPressStage; // (next stage to fire)
     unsigned long _doubleClickStarted;
     bool _doubleClickInProgress;
     bool _nextReleaseIsDoubleClick;
     bool _longPressFired;
+    bool _singleClickSent;
+    int _doubleClickWindow = 400; // ms (shrinks below _doubleClickTime when adaptive)
+    int _doubleClickLearned = 200; // ms (average time between the two presses of a double click)
+    
+    const VbsTapNode* _tapNodes = NULL;
+    int _tapLongTime = 250;
+    int _tapPauseTime = 400;
+    uint8_t _tapNode = 0; // (current node in the trie, 0 = no taps yet)
+    bool _tapClassified = false; // (current press already counted as long)
+    unsigned long _tapEdgeTime = 0;
     
     bool _lightKeepLit = false;
     bool _lightFeedbackFlashRunning = false;
     unsigned long _lightFeedbackFlashTime = 0;
     LightOverride _lightOverride = LIGHT_FREE;
     float _lightBrightness = 0.0f;
-    float _lightPulseTime = 0.0f;
+    float _lightPulsePhase = 0.0f;
+    uint8_t _lightPwm = 0;
+    
+    uint8_t _eepromWritePosition = sizeof(VbsButtonConfig);
     unsigned long _lastTimestamp = 0;
     
     // FUNCTIONS
     int readProgramSwitch() const;
-    bool readButton() const;
+    bool readButton();
+    void calibrateButton();
+    void updateThresholds();
+    void measurePressVelocity();
+    void sendPendingReports();
     
     void resetButtonState();
-    void updateLight();
+    void updateLight(const float pressedBrightness = 1.0f);
     void triggerFeedbackFlash();
+    void updateDoubleClickWindow();
+    void updateLongPressStages();
+    void startLongPress(const unsigned long timestamp);
+    uint8_t pollLongPressStage(const bool buttonState, const unsigned long timestamp);
+    int longPressProgress(const unsigned long timestamp) const;
+    float longPressBrightness(const unsigned long timestamp) const;
+    void stepTapPattern(const bool isLong, VbsTapButtonEvent& event);
+    
+    void captureConfig();
+    void applyConfig(const VbsButtonConfig& config);
+    void updateConfig();
     
 public:
     VbsBigRedButton(const uint8_t pinButton, const uint8_t pinLight, const uint8_t pinSwitch1, const uint8_t pinSwitch2);
     
     void SetLongPressTime(const int ms);
+    void SetLongPressStages(const int stage2, const int stage3 = 0);
     void SetDoubleClickTime(const int ms);
+    void SetSpeculativeSingleClick(const bool enabled);
+    void SetAdaptiveDoubleClick(const bool enabled);
+    // (samples the rest of the transition for up to 3.8 ms before the press event is returned)
+    void SetPressVelocitySampling(const bool enabled);
+    // (halves the time analogRead() waits, below the datasheet's 10 bit accuracy; call it in setup(), after init())
+    void SetFastAnalogRead(const bool enabled);
+    void SetPressTimestamps(const bool enabled);
+    void SetTapPatterns(const VbsTapNode* nodes);
+    void SetTapTiming(const int longTime, const int pauseTime);
     void SetLightChangeSpeed(const float speed);
     void SetLightFeedbackFlashSpeed(const int ms);
     void SetLightMaxBrightness(const float brightness);
     void SetLightPulse(const float frequency, const float size = 0.1f);
     
+    void SetKeyMapping(const int program, const int gesture, const uint8_t key, const uint8_t modifier = 0);
+    void SetKeyMappingPage1(const int program, const int gesture, const uint16_t key);
+    
+    bool LoadConfig();
+    
     void KeepLightLit(const bool lit);
+    void PressMappedKey(const int gesture);
+    void HoldMappedKey(const int gesture);
+    
+    VbsButtonCalibration GetCalibration() const;
+    inline uint8_t GetPressVelocity() const { return _pressVelocity; }
+    int GetLongPressProgress() const;
     
     int GetProgramIndex();
     VbsSingleButtonEvent PollSingleButtonEvent();
     VbsDualButtonEvent PollDualButtonEvent();
     VbsQuadButtonEvent PollQuadButtonEvent();
+    VbsTapButtonEvent PollTapButtonEvent();
 };
 
 #endif
\ No newline at end of file
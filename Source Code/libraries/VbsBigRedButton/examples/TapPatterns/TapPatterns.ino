@@ -0,0 +1,59 @@
+/*
+    TapPatterns.ino
+    
+    Morse-style tap patterns: every press is short or long (held longer than 250 ms), and a sequence
+    of them selects one of several keys with a single button, without flipping the program switches.
+    Each pattern is also sent to the host as a vendor report.
+    
+    The patterns are a trie: every node tells where a short and a long press continue, and which pattern
+    ends there. A pattern fires as soon as no longer pattern starts with it, otherwise after a 400 ms pause.
+    
+        .       F13     (node 1)
+        ..      F14     (node 2)
+        ..-     F15     (node 5)
+        .-      F16     (node 3, fires right away)
+        -       F17     (node 4)
+        -.      F18     (node 6, fires right away)
+*/
+
+#define IO_BUTTON A0
+#define IO_SWITCH_1 A2
+#define IO_SWITCH_2 A1
+#define IO_LIGHT 9
+
+#include <VbsKeyboard.h>
+#include <VbsBigRedButton.h>
+
+VbsBigRedButton BigRedButton(IO_BUTTON, IO_LIGHT, IO_SWITCH_1, IO_SWITCH_2);
+
+static const VbsTapNode TapPatterns[] PROGMEM = {
+    // Short, Long, Pattern
+    { 1, 4, 0 },    // 0: (root)
+    { 2, 3, 1 },    // 1: .
+    { 0, 5, 2 },    // 2: ..
+    { 0, 0, 4 },    // 3: .-
+    { 6, 0, 5 },    // 4: -
+    { 0, 0, 3 },    // 5: ..-
+    { 0, 0, 6 },    // 6: -.
+};
+
+static const uint8_t PatternKeys[] = { 0, KEY_F13, KEY_F14, KEY_F15, KEY_F16, KEY_F17, KEY_F18 };
+
+void setup()
+{
+    BigRedButton.SetTapPatterns(TapPatterns);
+    
+    // Shortest long press and the pause that ends a pattern (in milliseconds).
+    BigRedButton.SetTapTiming(250, 400);
+}
+
+void loop()
+{
+    auto event = BigRedButton.PollTapButtonEvent();
+    
+    if (event.Pattern)
+    {
+        Keyboard.PressKey(PatternKeys[event.Pattern]);
+        Keyboard.SendVendorReport(VENDOR_TAP_PATTERN, &event.Pattern, 1);
+    }
+}
@@ -0,0 +1,237 @@
+/*
+    MIT License
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in the
+    Software without restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+    Software, and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+       
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+    FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+    COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+    AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "VbsButtonBus.h"
+#include <util/crc16.h>
+
+static int MinMax(const int min, const int max, const int value)
+{
+    return value < min ? min : (value > max ? max : value);
+}
+
+static uint8_t Crc8(const uint8_t* data, const uint8_t length)
+{
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++)
+    {
+        crc = _crc8_ccitt_update(crc, data[i]);
+    }
+    return crc;
+}
+
+VbsButtonBus::VbsButtonBus(Stream& stream, const uint8_t id) :
+    _stream(stream),
+    _id(id)
+{
+    for (int i = 0; i < BUS_MAX_SATELLITES; i++)
+    {
+        _clockKnown[i] = false;
+    }
+}
+
+void VbsButtonBus::SetBatchTime(const int ms)
+{
+    _batchTime = MinMax(0, 1000, ms);
+}
+
+void VbsButtonBus::SetHoldBackTime(const int ms)
+{
+    _holdBackTime = MinMax(0, 1000, ms);
+}
+
+void VbsButtonBus::SendEvent(const uint8_t type)
+{
+    // If the batch is full, send it right away to make room
+    if (_pendingCount == BUS_MAX_EVENTS)
+    {
+        sendFrame(millis());
+    }
+    _pendingTypes[_pendingCount] = type;
+    _pendingTimes[_pendingCount] = millis();
+    _pendingCount++;
+}
+
+void VbsButtonBus::sendFrame(const unsigned long timestamp)
+{
+    uint8_t frame[BUS_MAX_FRAME_SIZE];
+    frame[0] = BUS_SYNC;
+    frame[1] = _id;
+    frame[2] = _sequence++;
+    frame[3] = _pendingCount;
+    frame[4] = timestamp;
+    frame[5] = timestamp >> 8;
+    frame[6] = timestamp >> 16;
+    frame[7] = timestamp >> 24;
+    
+    uint8_t length = BUS_HEADER_SIZE;
+    for (uint8_t i = 0; i < _pendingCount; i++)
+    {
+        const unsigned long age = min(timestamp - _pendingTimes[i], 0xFFFFUL);
+        frame[length++] = _pendingTypes[i];
+        frame[length++] = age;
+        frame[length++] = age >> 8;
+    }
+    frame[length] = Crc8(frame, length);
+    length++;
+    
+    _stream.write(frame, length);
+    _pendingCount = 0;
+    _lastFrameSent = timestamp;
+}
+
+void VbsButtonBus::receive()
+{
+    while (_stream.available() > 0)
+    {
+        const uint8_t value = _stream.read();
+        
+        // Wait for the start of a frame
+        if (_rxLength == 0 && value != BUS_SYNC) continue;
+        _rxFrame[_rxLength++] = value;
+        
+        while (_rxLength >= BUS_HEADER_SIZE)
+        {
+            // A bad count or CRC means the sync byte was data (or a corrupted frame), drop only
+            // that byte and look for the next sync in what was received after it
+            uint8_t used = 1;
+            if (_rxFrame[3] <= BUS_MAX_EVENTS)
+            {
+                const uint8_t frameLength = BUS_HEADER_SIZE + _rxFrame[3] * BUS_EVENT_SIZE + 1;
+                if (_rxLength < frameLength) break;
+                
+                if (Crc8(_rxFrame, frameLength - 1) == _rxFrame[frameLength - 1])
+                {
+                    if (_id == BUS_MASTER)
+                    {
+                        processFrame(millis());
+                    }
+                    else
+                    {
+                        // Satellites pass on frames from further down the chain as they are
+                        _stream.write(_rxFrame, frameLength);
+                    }
+                    used = frameLength;
+                }
+            }
+            
+            while (used < _rxLength && _rxFrame[used] != BUS_SYNC) used++;
+            _rxLength -= used;
+            memmove(_rxFrame, _rxFrame + used, _rxLength);
+        }
+    }
+}
+
+void VbsButtonBus::processFrame(const unsigned long timestamp)
+{
+    const uint8_t satellite = _rxFrame[1];
+    const uint8_t sequence = _rxFrame[2];
+    if (satellite >= BUS_MAX_SATELLITES) return;
+    
+    // Skip repeated frames, count missing ones
+    if (_clockKnown[satellite])
+    {
+        if (sequence == _lastSequence[satellite]) return;
+        _lostFrames += (uint8_t)(sequence - _lastSequence[satellite] - 1);
+    }
+    _lastSequence[satellite] = sequence;
+    
+    // Clock offset of the satellite: the transfer can only add delay, so the smallest difference seen is the closest.
+    // It creeps up by 1 ms per frame when the difference is bigger, to follow a satellite clock running slower.
+    const unsigned long satelliteTime =
+        (unsigned long)_rxFrame[4] |
+        ((unsigned long)_rxFrame[5] << 8) |
+        ((unsigned long)_rxFrame[6] << 16) |
+        ((unsigned long)_rxFrame[7] << 24);
+    const long offset = timestamp - satelliteTime;
+    if (!_clockKnown[satellite] || offset < _clockOffset[satellite])
+    {
+        _clockOffset[satellite] = offset;
+        _clockKnown[satellite] = true;
+    }
+    else if (offset > _clockOffset[satellite])
+    {
+        _clockOffset[satellite]++;
+    }
+    
+    for (uint8_t i = 0; i < _rxFrame[3]; i++)
+    {
+        const uint8_t* data = _rxFrame + BUS_HEADER_SIZE + i * BUS_EVENT_SIZE;
+        const unsigned int age = data[1] | (data[2] << 8);
+        
+        VbsBusEvent event;
+        event.Satellite = satellite;
+        event.Type = data[0];
+        event.Timestamp = satelliteTime - age + _clockOffset[satellite];
+        queueEvent(event);
+    }
+}
+
+void VbsButtonBus::queueEvent(const VbsBusEvent& event)
+{
+    if (_queueCount == BUS_QUEUE_SIZE)
+    {
+        _lostFrames++;
+        return;
+    }
+    
+    // Insert sorted, events mostly arrive in order so this rarely moves anything
+    uint8_t i = _queueCount;
+    while (i > 0 && (long)(_queue[i - 1].Timestamp - event.Timestamp) > 0)
+    {
+        _queue[i] = _queue[i - 1];
+        i--;
+    }
+    _queue[i] = event;
+    _queueCount++;
+}
+
+void VbsButtonBus::Update()
+{
+    receive();
+    
+    if (_id != BUS_MASTER)
+    {
+        // Send events once the first one waited the batch time, or a heartbeat to keep the clock offset fresh
+        const unsigned long timestamp = millis();
+        if ((_pendingCount > 0 && timestamp - _pendingTimes[0] >= (unsigned long)_batchTime) ||
+            timestamp - _lastFrameSent >= (unsigned long)_heartbeatTime)
+        {
+            sendFrame(timestamp);
+        }
+    }
+}
+
+bool VbsButtonBus::PollEvent(VbsBusEvent& event)
+{
+    // Events are held back for a while, so an earlier event from a slower satellite can still get in front
+    if (_queueCount == 0) return false;
+    if ((long)(millis() - _queue[0].Timestamp) < _holdBackTime) return false;
+    
+    event = _queue[0];
+    _queueCount--;
+    for (uint8_t i = 0; i < _queueCount; i++)
+    {
+        _queue[i] = _queue[i + 1];
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+/*
+    MIT License
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Permission is hereby granted, free of charge, to any person obtaining a copy of
+    this software and associated documentation files (the "Software"), to deal in the
+    Software without restriction, including without limitation the rights to use,
+    copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+    Software, and to permit persons to whom the Software is furnished to do so,
+    subject to the following conditions:
+    
+    The above copyright notice and this permission notice shall be included in all
+    copies or substantial portions of the Software.
+       
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+    FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+    COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+    AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+    WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef VBS_BUTTON_BUS_h
+#define VBS_BUTTON_BUS_h
+
+#include <Arduino.h>
+
+// Frame: sync, satellite id, sequence number, event count, satellite timestamp (4 bytes, LE),
+// events (type + age in ms before the timestamp, 3 bytes each), CRC-8
+#define BUS_SYNC            0xA5
+#define BUS_MAX_EVENTS      8
+#define BUS_HEADER_SIZE     8
+#define BUS_EVENT_SIZE      3
+#define BUS_MAX_FRAME_SIZE  (BUS_HEADER_SIZE + BUS_MAX_EVENTS * BUS_EVENT_SIZE + 1)
+#define BUS_MAX_SATELLITES  16
+#define BUS_QUEUE_SIZE      16
+
+// Satellite id of the master
+#define BUS_MASTER 0
+
+// Event types
+#define BUS_EVENT_PRESS                     1
+#define BUS_EVENT_RELEASE                   2
+#define BUS_EVENT_CLICK                     3
+#define BUS_EVENT_DOUBLE_CLICK              4
+#define BUS_EVENT_LONG_PRESS                5
+#define BUS_EVENT_LONG_PRESS_DOUBLE_CLICK   6
+
+struct VbsBusEvent
+{
+    uint8_t Satellite;
+    uint8_t Type;
+    unsigned long Timestamp; // master's millis()
+};
+
+class VbsButtonBus
+{
+private:
+    Stream& _stream;
+    const uint8_t _id;
+    
+    // CONFIG
+    int _batchTime = 5;
+    int _heartbeatTime = 100;
+    int _holdBackTime = 10;
+    
+    // SATELLITE STATE
+    uint8_t _sequence = 0;
+    uint8_t _pendingCount = 0;
+    uint8_t _pendingTypes[BUS_MAX_EVENTS];
+    unsigned long _pendingTimes[BUS_MAX_EVENTS];
+    unsigned long _lastFrameSent = 0;
+    
+    // RECEIVER STATE
+    uint8_t _rxFrame[BUS_MAX_FRAME_SIZE];
+    uint8_t _rxLength = 0;
+    
+    // MASTER STATE
+    long _clockOffset[BUS_MAX_SATELLITES];
+    bool _clockKnown[BUS_MAX_SATELLITES];
+    uint8_t _lastSequence[BUS_MAX_SATELLITES];
+    unsigned int _lostFrames = 0;
+    VbsBusEvent _queue[BUS_QUEUE_SIZE]; // (sorted by timestamp)
+    uint8_t _queueCount = 0;
+    
+    // FUNCTIONS
+    void receive();
+    void sendFrame(const unsigned long timestamp);
+    void processFrame(const unsigned long timestamp);
+    void queueEvent(const VbsBusEvent& event);
+    
+public:
+    VbsButtonBus(Stream& stream, const uint8_t id);
+    
+    void SetBatchTime(const int ms);
+    void SetHoldBackTime(const int ms);
+    
+    void Update();
+    
+    // Satellite
+    void SendEvent(const uint8_t type);
+    
+    // Master
+    bool PollEvent(VbsBusEvent& event);
+    inline unsigned int GetLostFrames() const { return _lostFrames; } // (also counts events dropped on a full queue)
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*
+    BusMaster.ino
+    
+    The master on the bus, connected to the PC over USB. Collects the events of all satellites
+    and sends them to the host as vendor reports, tagged by satellite id and ordered by the time
+    they happened on the satellite (converted to the master's clock).
+    
+    Vendor report data: satellite id, event type, timestamp (4 bytes, LE, milliseconds).
+*/
+
+// Serial port of the bus. The libraries need an ATmega32U4 board (Leonardo, Micro, Pro Micro), where
+// Serial is the USB port and Serial1 is the UART on pins 0 (RX) and 1 (TX).
+#define BUS_SERIAL Serial1
+#define BUS_SPEED 250000
+
+#include <VbsKeyboard.h>
+#include <VbsButtonBus.h>
+
+VbsButtonBus Bus(BUS_SERIAL, BUS_MASTER);
+
+void setup()
+{
+    BUS_SERIAL.begin(BUS_SPEED);
+}
+
+void loop()
+{
+    Bus.Update();
+    
+    // Reports the endpoint had no room for so far
+    Keyboard.FlushVendorReports();
+    
+    // A burst of events waits in the bus queue while the vendor queue is full, instead of pushing reports out of it
+    VbsBusEvent event;
+    while (Keyboard.GetVendorQueueSpace() > 0 && Bus.PollEvent(event))
+    {
+        const uint8_t data[6] = {
+            event.Satellite,
+            event.Type,
+            (uint8_t)event.Timestamp,
+            (uint8_t)(event.Timestamp >> 8),
+            (uint8_t)(event.Timestamp >> 16),
+            (uint8_t)(event.Timestamp >> 24)
+        };
+        Keyboard.SendVendorReport(VENDOR_BUS_EVENT, data, sizeof(data));
+    }
+}
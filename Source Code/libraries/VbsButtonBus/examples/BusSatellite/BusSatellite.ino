@@ -0,0 +1,44 @@
+/*
+    BusSatellite.ino
+    
+    A satellite button on the bus. Runs the button and gesture logic locally and sends the events
+    to the master in batches. The RX pin is connected to the TX of the next satellite down the chain
+    (if any), the TX pin to the RX of the next one towards the master.
+    
+    Every satellite needs a unique id between 1 and 15.
+*/
+
+#define SATELLITE_ID 1
+
+// Serial port of the bus. The libraries need an ATmega32U4 board (Leonardo, Micro, Pro Micro), where
+// Serial is the USB port and Serial1 is the UART on pins 0 (RX) and 1 (TX).
+#define BUS_SERIAL Serial1
+#define BUS_SPEED 250000
+
+#define IO_BUTTON A0
+#define IO_SWITCH_1 A2
+#define IO_SWITCH_2 A1
+#define IO_LIGHT 9
+
+#include <VbsBigRedButton.h>
+#include <VbsButtonBus.h>
+
+VbsBigRedButton BigRedButton(IO_BUTTON, IO_LIGHT, IO_SWITCH_1, IO_SWITCH_2);
+VbsButtonBus Bus(BUS_SERIAL, SATELLITE_ID);
+
+void setup()
+{
+    BUS_SERIAL.begin(BUS_SPEED);
+}
+
+void loop()
+{
+    auto event = BigRedButton.PollQuadButtonEvent();
+    
+    if (event.SingleClick) Bus.SendEvent(BUS_EVENT_CLICK);
+    if (event.DoubleClick) Bus.SendEvent(BUS_EVENT_DOUBLE_CLICK);
+    if (event.LongPress) Bus.SendEvent(BUS_EVENT_LONG_PRESS);
+    if (event.LongPressDoubleClick) Bus.SendEvent(BUS_EVENT_LONG_PRESS_DOUBLE_CLICK);
+    
+    Bus.Update();
+}
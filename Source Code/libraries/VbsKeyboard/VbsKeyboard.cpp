@@ -22,12 +22,10 @@
 */
 
 #include "VbsKeyboard.h"
+#include "VbsKeyboardLayouts.h"
 
 #if defined(USBCON)
 
-#define HID_REPORTID_KEYBOARD       0x02
-#define HID_REPORTID_GENERICDESKTOP 0x04
-
 static const uint8_t _hidReportDescriptorPage1[] PROGMEM = {
     0x05, 0x01,                                 // USAGE_PAGE (Generic Desktop)
     0x09, 0x06,                                 // USAGE (Keyboard)
@@ -93,16 +91,90 @@ static const uint8_t _hidReportDescriptorPage7[] PROGMEM = {
     0xc0,       // END_COLLECTION
 };
 
+static const uint8_t _hidReportDescriptorGamepad[] PROGMEM = {
+    0x05, 0x01,                                 // USAGE_PAGE (Generic Desktop)
+    0x09, 0x05,                                 // USAGE (Game Pad)
+    0xA1, 0x01,                                 // COLLECTION (Application)
+    0x85, HID_REPORTID_GAMEPAD,                 // REPORT_ID (HID_REPORTID_GAMEPAD)
+    
+    // 8 Buttons
+    0x05, 0x09,                                 // USAGE_PAGE (Button)
+    0x19, 0x01,                                 // USAGE_MINIMUM (Button 1)
+    0x29, 0x08,                                 // USAGE_MAXIMUM (Button 8)
+    0x15, 0x00,                                 // LOGICAL_MINIMUM (0)
+    0x25, 0x01,                                 // LOGICAL_MAXIMUM (1)
+    0x75, 0x01,                                 // REPORT_SIZE (1)
+    0x95, 0x08,                                 // REPORT_COUNT (8)
+    0x81, 0x02,                                 // INPUT (Data,Var,Abs)
+    
+    // Program index
+    0x05, 0x01,                                 // USAGE_PAGE (Generic Desktop)
+    0x09, 0x37,                                 // USAGE (Dial)
+    0x15, 0x00,                                 // LOGICAL_MINIMUM (0)
+    0x25, 0x03,                                 // LOGICAL_MAXIMUM (3)
+    0x75, 0x08,                                 // REPORT_SIZE (8)
+    0x95, 0x01,                                 // REPORT_COUNT (1)
+    0x81, 0x02,                                 // INPUT (Data,Var,Abs)
+    
+    // Analog axis
+    0x09, 0x36,                                 // USAGE (Slider)
+    0x26, 0xFF, 0x00,                           // LOGICAL_MAXIMUM (255)
+    0x81, 0x02,                                 // INPUT (Data,Var,Abs)
+    0xC0 // END_COLLECTION
+};
+
+static const uint8_t _hidReportDescriptorVendor[] PROGMEM = {
+    0x06, 0x00, 0xFF,                           // USAGE_PAGE (Vendor Defined 0xFF00)
+    0x09, 0x01,                                 // USAGE (Vendor Usage 1)
+    0xA1, 0x01,                                 // COLLECTION (Application)
+    0x85, HID_REPORTID_VENDOR,                  // REPORT_ID (HID_REPORTID_VENDOR)
+    
+    // Type + data bytes
+    0x15, 0x00,                                 // LOGICAL_MINIMUM (0)
+    0x26, 0xFF, 0x00,                           // LOGICAL_MAXIMUM (255)
+    0x75, 0x08,                                 // REPORT_SIZE (8)
+    0x95, sizeof(VendorReport),                 // REPORT_COUNT (8)
+    0x09, 0x01,                                 // USAGE (Vendor Usage 1)
+    0x81, 0x02,                                 // INPUT (Data,Var,Abs)
+    
+    // Feature report
+    0x85, HID_REPORTID_FEATURE,                 // REPORT_ID (HID_REPORTID_FEATURE)
+    0x95, FEATURE_REPORT_SIZE,                  // REPORT_COUNT (192)
+    0x09, 0x02,                                 // USAGE (Vendor Usage 2)
+    0xB1, 0x02,                                 // FEATURE (Data,Var,Abs)
+    
+    // Clock sync report (host time in microseconds)
+    0x85, HID_REPORTID_CLOCK_SYNC,              // REPORT_ID (HID_REPORTID_CLOCK_SYNC)
+    0x95, 0x04,                                 // REPORT_COUNT (4)
+    0x09, 0x03,                                 // USAGE (Vendor Usage 3)
+    0xB1, 0x02,                                 // FEATURE (Data,Var,Abs)
+    0xC0 // END_COLLECTION
+};
+
 // Implementation of PluggableUSBModule
 int VbsKeyboard::getInterface(uint8_t* interfaceCount)
 {
-    *interfaceCount += 1; // uses 1
+    *interfaceCount += 2; // uses 2
+    
+    // Keys and gamepad, nothing else is sent on this endpoint so key reports never wait behind other data
     HIDDescriptor hidInterface = {
         D_INTERFACE(pluggedInterface, 1, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_NONE, HID_PROTOCOL_NONE),
         D_HIDREPORT(_descriptorSize),
         D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, 0x01)
     };
-    return USB_SendControl(0, &hidInterface, sizeof(hidInterface));
+    
+    // Vendor defined reports, feature reports
+    HIDDescriptor vendorInterface = {
+        D_INTERFACE(pluggedInterface + 1, 1, USB_DEVICE_CLASS_HUMAN_INTERFACE, HID_SUBCLASS_NONE, HID_PROTOCOL_NONE),
+        D_HIDREPORT(sizeof(_hidReportDescriptorVendor)),
+        D_ENDPOINT(USB_ENDPOINT_IN(pluggedEndpoint + 1), USB_ENDPOINT_TYPE_INTERRUPT, USB_EP_SIZE, 0x01)
+    };
+    
+    int res = USB_SendControl(0, &hidInterface, sizeof(hidInterface));
+    if (res == -1) return -1;
+    int vendorRes = USB_SendControl(0, &vendorInterface, sizeof(vendorInterface));
+    if (vendorRes == -1) return -1;
+    return res + vendorRes;
 }
 
 // Implementation of PluggableUSBModule
@@ -113,6 +185,10 @@ int VbsKeyboard::getDescriptor(USBSetup& setup)
     if (setup.wValueH != HID_REPORT_DESCRIPTOR_TYPE) return 0;
     
     // In a HID Class Descriptor wIndex cointains the interface number
+    if (setup.wIndex == pluggedInterface + 1)
+    {
+        return USB_SendControl(TRANSFER_PGM, _hidReportDescriptorVendor, sizeof(_hidReportDescriptorVendor));
+    }
     if (setup.wIndex != pluggedInterface) return 0;
     
     int total = 0;
@@ -145,15 +221,39 @@ uint8_t VbsKeyboard::getShortName(char *name)
 // Implementation of PluggableUSBModule
 bool VbsKeyboard::setup(USBSetup& setup)
 {
-    if (pluggedInterface != setup.wIndex) return false;
+    if (pluggedInterface != setup.wIndex && pluggedInterface + 1 != setup.wIndex) return false;
     
     uint8_t request = setup.bRequest;
     uint8_t requestType = setup.bmRequestType;
+    const bool vendorInterface = pluggedInterface + 1 == setup.wIndex;
     
     if (requestType == REQUEST_DEVICETOHOST_CLASS_INTERFACE)
     {
         if (request == HID_GET_REPORT)
         {
+            if (vendorInterface && setup.wValueH == HID_REPORT_TYPE_FEATURE && setup.wValueL == HID_REPORTID_FEATURE)
+            {
+                // Report ID, data, then zero padding up to the declared size
+                const uint8_t id = HID_REPORTID_FEATURE;
+                const uint8_t zero = 0;
+                USB_SendControl(0, &id, 1);
+                USB_SendControl(0, _featureData, _featureLength);
+                for (int i = _featureLength; i < FEATURE_REPORT_SIZE; i++)
+                {
+                    USB_SendControl(0, &zero, 1);
+                }
+                return true;
+            }
+            if (vendorInterface && setup.wValueH == HID_REPORT_TYPE_FEATURE && setup.wValueL == HID_REPORTID_CLOCK_SYNC)
+            {
+                // Current host time as estimated by the device, lets the host check the remaining error
+                uint8_t report[5];
+                const uint32_t hostTime = _clockSync.HostTime(micros());
+                report[0] = HID_REPORTID_CLOCK_SYNC;
+                memcpy(report + 1, &hostTime, 4);
+                USB_SendControl(0, report, sizeof(report));
+                return true;
+            }
             // TODO: HID_GetReport();
             return true;
         }
@@ -184,7 +284,32 @@ bool VbsKeyboard::setup(USBSetup& setup)
         }
         else if (request == HID_SET_REPORT)
         {
-            if (setup.wLength == 2) 
+            if (vendorInterface && setup.wValueH == HID_REPORT_TYPE_FEATURE && setup.wValueL == HID_REPORTID_FEATURE)
+            {
+                if (setup.wLength == sizeof(_featureBuffer) && !_featureReceived &&
+                    USB_RecvControl(_featureBuffer, sizeof(_featureBuffer)) == sizeof(_featureBuffer))
+                {
+                    _featureReceived = true;
+                    return true;
+                }
+                return false;
+            }
+            if (vendorInterface && setup.wValueH == HID_REPORT_TYPE_FEATURE && setup.wValueL == HID_REPORTID_CLOCK_SYNC)
+            {
+                uint8_t report[5];
+                if (setup.wLength == sizeof(report) && USB_RecvControl(report, sizeof(report)) == sizeof(report))
+                {
+                    // The report arrives a fairly constant time after the host took the timestamp
+                    const uint32_t local = micros();
+                    uint32_t host;
+                    memcpy(&host, report + 1, 4);
+                    _clockSync.Update(host, local);
+                    return true;
+                }
+                return false;
+            }
+            
+            if (!vendorInterface && setup.wLength == 2) 
             {
                 uint8_t data[2];
                 if (USB_RecvControl(data, 2) == 2) 
@@ -199,11 +324,18 @@ bool VbsKeyboard::setup(USBSetup& setup)
 }
 
 VbsKeyboard::VbsKeyboard(void) :
-    PluggableUSBModule(1, 1, _epType),
+    PluggableUSBModule(2, 2, _epType),
     _rootNode(NULL), _descriptorSize(0),
-    _protocol(HID_REPORT_PROTOCOL), _idle(1)
+    _protocol(HID_REPORT_PROTOCOL), _idle(1),
+    _repeatDelay(500), _repeatPeriod(33),
+    _repeatKey(0), _repeatCountdown(0), _repeatWait(0), _reportBusy(false),
+    _timerRunning(false), _savedTCCR3A(0), _savedTCCR3B(0), _savedOCR3A(0), _savedTIMSK3(0),
+    _layout(_layoutUS), _typeNext(NULL), _typeDeadSpace(false),
+    _featureData(NULL), _featureLength(0), _featureReceived(false),
+    _vendorQueueStart(0), _vendorQueueCount(0)
 {
     _epType[0] = EP_TYPE_INTERRUPT_IN;
+    _epType[1] = EP_TYPE_INTERRUPT_IN;
     PluggableUSB().plug(this);
     
     // Append generic keyboard descriptor
@@ -213,6 +345,12 @@ VbsKeyboard::VbsKeyboard(void) :
     // Append system keyboard descriptor
     static HIDSubDescriptor nodeConsumer(_hidReportDescriptorPage1, sizeof(_hidReportDescriptorPage1));
     AppendDescriptor(&nodeConsumer);
+    
+    // Append gamepad descriptor
+    static HIDSubDescriptor nodeGamepad(_hidReportDescriptorGamepad, sizeof(_hidReportDescriptorGamepad));
+    AppendDescriptor(&nodeGamepad);
+    
+    // (The vendor descriptor belongs to the second interface)
 }
 
 void VbsKeyboard::AppendDescriptor(HIDSubDescriptor* node)
@@ -238,8 +376,197 @@ void VbsKeyboard::AppendDescriptor(HIDSubDescriptor* node)
 
 void VbsKeyboard::SendReport(uint8_t id, void* data, int len)
 {
-    if (USB_Send(pluggedEndpoint, &id, 1) < 0) return;
-    if (USB_Send(pluggedEndpoint | TRANSFER_RELEASE, data, len) < 0) return;
+    // Keep the timer from slipping a report in between the ID and the data
+    _reportBusy = true;
+    if (USB_Send(pluggedEndpoint, &id, 1) >= 0)
+    {
+        USB_Send(pluggedEndpoint | TRANSFER_RELEASE, data, len);
+    }
+    _reportBusy = false;
+}
+
+// Timer3 is set to CTC mode with a 1 ms period, which matches the USB frame and the 1 ms polling
+// interval of the endpoint. This takes over Timer3, so PWM on D5 is not available while it runs,
+// the previous settings are restored when it stops.
+void VbsKeyboard::StartTimer()
+{
+    const uint8_t oldSREG = SREG;
+    cli();
+    if (!_timerRunning)
+    {
+        _savedTCCR3A = TCCR3A;
+        _savedTCCR3B = TCCR3B;
+        _savedOCR3A = OCR3A;
+        _savedTIMSK3 = TIMSK3;
+        _timerRunning = true;
+    }
+    
+    TIMSK3 &= ~(1 << OCIE3A);
+    TCCR3A = 0;
+    TCCR3B = (1 << WGM32) | (1 << CS31) | (1 << CS30); // CTC, prescaler 64
+    OCR3A = (F_CPU / 64 / 1000) - 1;
+    TCNT3 = 0;
+    TIMSK3 |= (1 << OCIE3A);
+    SREG = oldSREG;
+}
+
+void VbsKeyboard::StopTimer()
+{
+    const uint8_t oldSREG = SREG;
+    cli();
+    if (_timerRunning)
+    {
+        TIMSK3 = _savedTIMSK3;
+        TCCR3B = 0;
+        TCCR3A = _savedTCCR3A;
+        OCR3A = _savedOCR3A;
+        TCNT3 = 0;
+        TCCR3B = _savedTCCR3B;
+        _timerRunning = false;
+    }
+    SREG = oldSREG;
+}
+
+void VbsKeyboard::ServiceTimer()
+{
+    if (_reportBusy) return;
+    
+    if (_repeatCountdown > 0)
+    {
+        _repeatCountdown--;
+        return;
+    }
+    
+    // Never block in the interrupt, if the host has not picked up the last report yet try again next tick
+    if (USB_SendSpace(pluggedEndpoint) < sizeof(KeyReportPage7) + 1) return;
+    
+    if (_typeNext)
+    {
+        ServiceTyping();
+        return;
+    }
+    
+    // Alternate between release and press, modifiers remain held all the way
+    if (_keyReportPage7.keys[0])
+    {
+        _keyReportPage7.keys[0] = 0;
+        _repeatCountdown = _repeatWait - 2;
+        _repeatWait = _repeatPeriod;
+    }
+    else
+    {
+        _keyReportPage7.keys[0] = _repeatKey;
+        _repeatCountdown = 0;
+    }
+    SendReportPage7();
+}
+
+bool VbsKeyboard::LookupChar(char c, uint8_t& key, uint8_t& modifier) const
+{
+    modifier = MOD_NONE;
+    if (c == '\n')
+    {
+        key = KEY_ENTER;
+        return false;
+    }
+    if (c == '\t')
+    {
+        key = KEY_TAB;
+        return false;
+    }
+    if (c < 0x20 || c > 0x7E)
+    {
+        key = 0;
+        return false;
+    }
+    
+    const uint8_t* entry = _layout + (c - 0x20) * 2;
+    const uint8_t value = pgm_read_byte(entry);
+    key = value & LAYOUT_KEY_MASK;
+    modifier = pgm_read_byte(entry + 1);
+    return value & LAYOUT_DEAD;
+}
+
+void VbsKeyboard::ServiceTyping()
+{
+    // Find the next character the layout can type
+    char c;
+    uint8_t key = 0;
+    uint8_t modifier = MOD_NONE;
+    bool dead = false;
+    while (true)
+    {
+        c = _typeDeadSpace ? ' ' : pgm_read_byte(_typeNext);
+        if (c == 0) break;
+        
+        dead = LookupChar(c, key, modifier);
+        if (key) break;
+        _typeNext++;
+    }
+    
+    const uint8_t heldKey = _keyReportPage7.keys[0];
+    
+    // End of text, release the last key and stop
+    if (c == 0)
+    {
+        if (heldKey || _keyReportPage7.modifiers)
+        {
+            _keyReportPage7.keys[0] = 0;
+            _keyReportPage7.modifiers = 0;
+            SendReportPage7();
+        }
+        else
+        {
+            _typeNext = NULL;
+            StopTimer();
+        }
+        return;
+    }
+    
+    // Replacing one key with another in the same report types both without a release in between,
+    // this is only safe if the key is different and the modifiers stay the same.
+    if (heldKey && (heldKey == key || _keyReportPage7.modifiers != modifier))
+    {
+        _keyReportPage7.keys[0] = 0;
+        _keyReportPage7.modifiers = 0;
+        SendReportPage7();
+        return;
+    }
+    
+    _keyReportPage7.keys[0] = key;
+    _keyReportPage7.modifiers = modifier;
+    SendReportPage7();
+    
+    if (_typeDeadSpace)
+    {
+        _typeDeadSpace = false;
+    }
+    else
+    {
+        _typeNext++;
+        _typeDeadSpace = dead;
+    }
+}
+
+bool VbsKeyboard::TypeString(const __FlashStringHelper* text)
+{
+    if (_typeNext) return false;
+    
+    // Start from a clean report, this also stops any key repeat
+    HoldKey(0, 0);
+    
+    _typeDeadSpace = false;
+    _typeNext = reinterpret_cast<const char*>(text);
+    StartTimer();
+    return true;
+}
+
+void VbsKeyboard::SetLayout(uint8_t layout)
+{
+    if (layout < sizeof(_layouts) / sizeof(_layouts[0]))
+    {
+        _layout = _layouts[layout];
+    }
 }
 
 void VbsKeyboard::PressKeyPage1(uint16_t key) 
@@ -264,6 +591,11 @@ void VbsKeyboard::PressKey(uint8_t key, uint8_t modifier)
 
 void VbsKeyboard::HoldKey(uint8_t key, uint8_t modifier)
 {
+    // Manual keys take over, cancel repeat and typing (a leftover countdown would delay the next text)
+    StopTimer();
+    _typeNext = NULL;
+    _repeatCountdown = 0;
+    
     _keyReportPage7.keys[0] = key;
     _keyReportPage7.keys[1] = 0;	
     _keyReportPage7.keys[2] = 0;
@@ -274,6 +606,149 @@ void VbsKeyboard::HoldKey(uint8_t key, uint8_t modifier)
     SendReportPage7();
 }
 
+void VbsKeyboard::HoldKeyRepeat(uint8_t key, uint8_t modifier)
+{
+    HoldKey(key, modifier);
+    if (!key) return;
+    
+    // First release comes on the next frame, so the host never sees the key held long enough for its own typematic
+    _repeatKey = key;
+    _repeatWait = _repeatDelay;
+    _repeatCountdown = 0;
+    StartTimer();
+}
+
+void VbsKeyboard::SetAutoRepeat(uint16_t delay, uint16_t rate)
+{
+    // Press and release each take a frame, so the fastest possible period is 2 ms
+    _repeatDelay = delay < 2 ? 2 : (delay > 10000 ? 10000 : delay);
+    _repeatPeriod = rate >= 500 ? 2 : (rate < 1 ? 1000 : 1000 / rate);
+}
+
+void VbsKeyboard::SetGamepad(uint8_t buttons, uint8_t program, uint8_t axis)
+{
+    if (_gamepadReport.buttons == buttons && _gamepadReport.program == program && _gamepadReport.axis == axis) return;
+    
+    _gamepadReport.buttons = buttons;
+    _gamepadReport.program = program;
+    _gamepadReport.axis = axis;
+    SendReport(HID_REPORTID_GAMEPAD, &_gamepadReport, sizeof(GamepadReport));
+}
+
+void VbsKeyboard::SendVendorReport(uint8_t type, const void* data, uint8_t length)
+{
+    // Drop the oldest one when the host is not reading them
+    if (_vendorQueueCount == VENDOR_QUEUE_SIZE)
+    {
+        _vendorQueueStart = (_vendorQueueStart + 1) % VENDOR_QUEUE_SIZE;
+        _vendorQueueCount--;
+    }
+    
+    VendorReport& report = _vendorQueue[(_vendorQueueStart + _vendorQueueCount) % VENDOR_QUEUE_SIZE];
+    memset(&report, 0, sizeof(VendorReport));
+    report.type = type;
+    memcpy(report.data, data, length < VENDOR_REPORT_DATA_SIZE ? length : VENDOR_REPORT_DATA_SIZE);
+    _vendorQueueCount++;
+    
+    FlushVendorReports();
+}
+
+void VbsKeyboard::FlushVendorReports()
+{
+    // USB_Send() would wait up to 250 ms for a bank of the endpoint, only send when there is room
+    const uint8_t id = HID_REPORTID_VENDOR;
+    while (_vendorQueueCount > 0 && USB_SendSpace(pluggedEndpoint + 1) >= sizeof(VendorReport) + 1)
+    {
+        if (USB_Send(pluggedEndpoint + 1, &id, 1) >= 0)
+        {
+            USB_Send((pluggedEndpoint + 1) | TRANSFER_RELEASE, &_vendorQueue[_vendorQueueStart], sizeof(VendorReport));
+        }
+        _vendorQueueStart = (_vendorQueueStart + 1) % VENDOR_QUEUE_SIZE;
+        _vendorQueueCount--;
+    }
+}
+
+void VbsKeyboard::SetFeatureReport(const void* data, uint8_t length)
+{
+    _featureData = data;
+    _featureLength = length < FEATURE_REPORT_SIZE ? length : FEATURE_REPORT_SIZE;
+}
+
+bool VbsKeyboard::ReadFeatureReport(void* data, uint8_t length)
+{
+    if (!_featureReceived) return false;
+    
+    // (The buffer is not written again until this flag is cleared)
+    memcpy(data, _featureBuffer + 1, length < FEATURE_REPORT_SIZE ? length : FEATURE_REPORT_SIZE);
+    _featureReceived = false;
+    return true;
+}
+
+uint32_t VbsKeyboard::GetHostTime(uint32_t localMicros) const
+{
+    // The sync state is updated in the USB interrupt
+    const uint8_t oldSREG = SREG;
+    cli();
+    const uint32_t hostTime = _clockSync.HostTime(localMicros);
+    SREG = oldSREG;
+    return hostTime;
+}
+
+bool VbsKeyboard::IsClockSynced()
+{
+    const uint32_t now = micros();
+    const uint8_t oldSREG = SREG;
+    cli();
+    const bool synced = _clockSync.IsValid(now);
+    SREG = oldSREG;
+    return synced;
+}
+
+VbsClockSync::VbsClockSync() :
+    _valid(false), _local(0), _host(0), _drift(0.0f)
+{
+}
+
+uint32_t VbsClockSync::HostTime(uint32_t local) const
+{
+    // Elapsed time since the last sync, corrected with the drift (signed, a press can be
+    // timestamped just before a sync, valid up to 35 minutes either way)
+    const int32_t elapsed = (int32_t)(local - _local);
+    return _host + elapsed + (int32_t)(elapsed * _drift);
+}
+
+bool VbsClockSync::IsValid(uint32_t local)
+{
+    // (micros() wraps around after 71 minutes, so an old sync must not stay around to look new again)
+    if (_valid && local - _local > CLOCK_SYNC_MAX_AGE) _valid = false;
+    return _valid;
+}
+
+void VbsClockSync::Update(uint32_t host, uint32_t local)
+{
+    const int32_t error = (int32_t)(host - HostTime(local));
+    const uint32_t interval = local - _local;
+    
+    if (!IsValid(local) || error > CLOCK_SYNC_RESET_ERROR || error < -CLOCK_SYNC_RESET_ERROR)
+    {
+        _host = host;
+        _local = local;
+        _drift = 0.0f;
+        _valid = true;
+        return;
+    }
+    
+    // The error is mostly USB jitter, so only a part of it is corrected each time: a quarter goes into the
+    // offset, and the drift follows the rate error over the interval even slower
+    if (interval >= CLOCK_SYNC_MIN_INTERVAL)
+    {
+        const float drift = _drift + (float)error / interval / 16;
+        _drift = drift > CLOCK_SYNC_MAX_DRIFT ? CLOCK_SYNC_MAX_DRIFT : (drift < -CLOCK_SYNC_MAX_DRIFT ? -CLOCK_SYNC_MAX_DRIFT : drift);
+    }
+    _host = host - error + error / 4;
+    _local = local;
+}
+
 bool VbsKeyboard::GetLedState(uint8_t mask) const
 {
     return _ledsState & mask;
@@ -282,4 +757,9 @@ bool VbsKeyboard::GetLedState(uint8_t mask) const
 
 VbsKeyboard Keyboard;
 
+ISR(TIMER3_COMPA_vect)
+{
+    Keyboard.ServiceTimer();
+}
+
 #endif /* if defined(USBCON) */
\ No newline at end of file
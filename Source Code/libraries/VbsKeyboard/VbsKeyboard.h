@@ -94,6 +94,21 @@ public:
     const uint16_t length;
 };
 
+// Report IDs and vendor report types (shared with host software)
+#include "VbsReportIds.h"
+
+// Size of the vendor defined feature report (without the report ID)
+#define FEATURE_REPORT_SIZE 192
+
+// Vendor reports waiting for room on the endpoint (the oldest one is dropped when full)
+#define VENDOR_QUEUE_SIZE 4
+
+// Clock synchronization (times in microseconds)
+#define CLOCK_SYNC_RESET_ERROR      100000  // Start over when the estimate is off by more than this
+#define CLOCK_SYNC_MIN_INTERVAL     100000  // Drift is only estimated from syncs at least this far apart
+#define CLOCK_SYNC_MAX_DRIFT        0.001f  // 1000 ppm, way more than any crystal or resonator
+#define CLOCK_SYNC_MAX_AGE          600000000UL // Drop the estimate after 10 minutes without a sync (the math works up to 35)
+
 #define D_HIDREPORT(length) { 9, 0x21, 0x01, 0x01, 0, 1, 0x22, lowByte(length), highByte(length) }
 
 
@@ -104,6 +119,11 @@ public:
 #define KB_LED_CAPS_LOCK    0x02
 #define KB_LED_SCROLL_LOCK  0x04
 
+// Keyboard layouts for TypeString()
+#define KB_LAYOUT_US        0
+#define KB_LAYOUT_HU        1
+#define KB_LAYOUT_DE        2
+
 // Modifiers (page 7)
 #define MOD_NONE         0x00
 #define MOD_LEFT_CTRL    0x01
@@ -205,6 +225,44 @@ typedef union {
     uint16_t keys[4];
 } KeyReportPage1;
 
+// Gamepad: 8 buttons, program index (dial) and one analog axis (slider)
+typedef struct
+{
+    uint8_t buttons;
+    uint8_t program;
+    uint8_t axis;
+} GamepadReport;
+
+// Vendor defined report: a type byte and up to 7 bytes of data
+#define VENDOR_REPORT_DATA_SIZE 7
+typedef struct
+{
+    uint8_t type;
+    uint8_t data[VENDOR_REPORT_DATA_SIZE];
+} VendorReport;
+
+
+// Estimate of the host clock from the times the host sent, following the offset and the drift of the local
+// clock (times in microseconds, local is micros(). Not interrupt safe on its own)
+class VbsClockSync
+{
+public:
+    VbsClockSync();
+    
+    void Update(uint32_t host, uint32_t local);
+    uint32_t HostTime(uint32_t local) const;
+    
+    // False before the first sync, or when the last one is older than CLOCK_SYNC_MAX_AGE (which also drops it)
+    bool IsValid(uint32_t local);
+    inline float GetDrift() const { return _drift; }
+    
+private:
+    bool _valid;
+    uint32_t _local;
+    uint32_t _host;
+    float _drift;
+};
+
 
 class VbsKeyboard : public PluggableUSBModule
 {
@@ -217,10 +275,46 @@ public:
     // Page 0x07 (Keyboard/Keypad)
     void PressKey(uint8_t key, uint8_t modifier = MOD_NONE);
     void HoldKey(uint8_t key, uint8_t modifier = MOD_NONE);
+    void HoldKeyRepeat(uint8_t key, uint8_t modifier = MOD_NONE);
     inline void ReleaseKey() { HoldKey(0, 0); }
     
+    // Device-side auto-repeat for HoldKeyRepeat() (delay in milliseconds, rate in repeats per second)
+    void SetAutoRepeat(uint16_t delay, uint16_t rate);
+    
+    // Text typing in the background, one report per USB frame (the string must be in PROGMEM, use F("..."))
+    bool TypeString(const __FlashStringHelper* text);
+    inline bool IsTyping() const { return _typeNext != NULL; }
+    void SetLayout(uint8_t layout);
+    
     bool GetLedState(uint8_t mask) const;
     
+    // Gamepad (only sent when something changed)
+    void SetGamepad(uint8_t buttons, uint8_t program = 0, uint8_t axis = 0);
+    
+    // Vendor defined page, for data that is not a key (the rest of the data is zero filled)
+    // (sent on a separate interface and endpoint, so it never delays key reports. Never waits for the host either:
+    // when the endpoint is full, because nobody reads that interface, the report is queued and sent by a later
+    // SendVendorReport() or FlushVendorReports() call. A full queue drops its oldest report, a sketch with more
+    // reports than that in a row can wait for GetVendorQueueSpace() instead)
+    void SendVendorReport(uint8_t type, const void* data, uint8_t length);
+    void FlushVendorReports();
+    inline uint8_t GetVendorQueueSpace() const { return VENDOR_QUEUE_SIZE - _vendorQueueCount; }
+    
+    // Vendor defined feature report: data returned when the host reads it, and the last one the host wrote
+    // (returns true once for each report received)
+    void SetFeatureReport(const void* data, uint8_t length);
+    bool ReadFeatureReport(void* data, uint8_t length);
+    
+    // Host clock, estimated from the times the host writes into the clock sync feature report
+    // (converts a micros() value of this device to the host clock. Not synced before the first sync, or when
+    // the host has not sent one for CLOCK_SYNC_MAX_AGE)
+    uint32_t GetHostTime(uint32_t localMicros) const;
+    bool IsClockSynced();
+    
+    // Called from the Timer3 interrupt every millisecond, do not call directly
+    // (the library defines that interrupt, so tone() cannot be used together with it)
+    void ServiceTimer();
+    
 protected:
     // Implementation of the PluggableUSBModule
     int getInterface(uint8_t* interfaceCount);
@@ -230,7 +324,7 @@ protected:
     
 private:
     // HID
-    uint8_t _epType[1];
+    uint8_t _epType[2];
     HIDSubDescriptor* _rootNode;
     uint16_t _descriptorSize;
     uint8_t _protocol;
@@ -239,9 +333,48 @@ private:
     // Keyboard
     KeyReportPage1 _keyReportPage1;
     KeyReportPage7 _keyReportPage7;
+    GamepadReport _gamepadReport;
     uint8_t _ledsState;
     
+    // Auto-repeat (in timer ticks, 1 tick = 1 ms = 1 USB frame)
+    uint16_t _repeatDelay;
+    uint16_t _repeatPeriod;
+    volatile uint8_t _repeatKey;
+    volatile uint16_t _repeatCountdown;
+    volatile uint16_t _repeatWait;
+    volatile bool _reportBusy;
+    
+    // Timer3 settings of the core (PWM on D5), restored when the timer is not needed
+    volatile bool _timerRunning;
+    uint8_t _savedTCCR3A;
+    uint8_t _savedTCCR3B;
+    uint16_t _savedOCR3A;
+    uint8_t _savedTIMSK3;
+    
+    // Typing
+    const uint8_t* _layout;
+    const char* volatile _typeNext;
+    bool _typeDeadSpace;
+    
+    // Feature report
+    const void* _featureData;
+    uint8_t _featureLength;
+    uint8_t _featureBuffer[1 + FEATURE_REPORT_SIZE];
+    volatile bool _featureReceived;
+    
+    // Vendor reports waiting for room
+    VendorReport _vendorQueue[VENDOR_QUEUE_SIZE];
+    uint8_t _vendorQueueStart;
+    uint8_t _vendorQueueCount;
+    
+    // Clock sync (updated in the USB interrupt)
+    VbsClockSync _clockSync;
+    
     void SendReport(uint8_t id, void* data, int len);
+    void StartTimer();
+    void StopTimer();
+    void ServiceTyping();
+    bool LookupChar(char c, uint8_t& key, uint8_t& modifier) const;
     
     void AppendDescriptor(HIDSubDescriptor* node);
 };
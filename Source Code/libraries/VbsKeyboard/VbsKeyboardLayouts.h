@@ -0,0 +1,326 @@
+/*
+    VbsKeyboardLayouts.h
+    
+    Copyright (c) 2020, Balazs Vecsey, www.vbstudio.hu
+    
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+    
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+*/
+
+// ASCII (0x20 - 0x7E) to page 0x07 key code tables used by TypeString(), only included by VbsKeyboard.cpp.
+// Each character is two bytes: key code and modifiers. Characters on dead keys are marked, those are
+// followed by a space to make them appear on their own. AltGr is sent as right Alt.
+
+#ifndef VBS_KEYBOARD_LAYOUTS_h
+#define VBS_KEYBOARD_LAYOUTS_h
+
+#define LAYOUT_DEAD      0x80
+#define LAYOUT_KEY_MASK  0x7F
+#define DEAD             LAYOUT_DEAD
+
+static const uint8_t _layoutUS[] PROGMEM = {
+    0x2c,        MOD_NONE,        // space
+    0x1e,        MOD_LEFT_SHIFT,  // !
+    0x34,        MOD_LEFT_SHIFT,  // "
+    0x20,        MOD_LEFT_SHIFT,  // #
+    0x21,        MOD_LEFT_SHIFT,  // $
+    0x22,        MOD_LEFT_SHIFT,  // %
+    0x24,        MOD_LEFT_SHIFT,  // &
+    0x34,        MOD_NONE,        // quote
+    0x26,        MOD_LEFT_SHIFT,  // (
+    0x27,        MOD_LEFT_SHIFT,  // )
+    0x25,        MOD_LEFT_SHIFT,  // *
+    0x2e,        MOD_LEFT_SHIFT,  // +
+    0x36,        MOD_NONE,        // ,
+    0x2d,        MOD_NONE,        // -
+    0x37,        MOD_NONE,        // .
+    0x38,        MOD_NONE,        // /
+    0x27,        MOD_NONE,        // 0
+    0x1e,        MOD_NONE,        // 1
+    0x1f,        MOD_NONE,        // 2
+    0x20,        MOD_NONE,        // 3
+    0x21,        MOD_NONE,        // 4
+    0x22,        MOD_NONE,        // 5
+    0x23,        MOD_NONE,        // 6
+    0x24,        MOD_NONE,        // 7
+    0x25,        MOD_NONE,        // 8
+    0x26,        MOD_NONE,        // 9
+    0x33,        MOD_LEFT_SHIFT,  // :
+    0x33,        MOD_NONE,        // ;
+    0x36,        MOD_LEFT_SHIFT,  // <
+    0x2e,        MOD_NONE,        // =
+    0x37,        MOD_LEFT_SHIFT,  // >
+    0x38,        MOD_LEFT_SHIFT,  // ?
+    0x1f,        MOD_LEFT_SHIFT,  // @
+    0x04,        MOD_LEFT_SHIFT,  // A
+    0x05,        MOD_LEFT_SHIFT,  // B
+    0x06,        MOD_LEFT_SHIFT,  // C
+    0x07,        MOD_LEFT_SHIFT,  // D
+    0x08,        MOD_LEFT_SHIFT,  // E
+    0x09,        MOD_LEFT_SHIFT,  // F
+    0x0a,        MOD_LEFT_SHIFT,  // G
+    0x0b,        MOD_LEFT_SHIFT,  // H
+    0x0c,        MOD_LEFT_SHIFT,  // I
+    0x0d,        MOD_LEFT_SHIFT,  // J
+    0x0e,        MOD_LEFT_SHIFT,  // K
+    0x0f,        MOD_LEFT_SHIFT,  // L
+    0x10,        MOD_LEFT_SHIFT,  // M
+    0x11,        MOD_LEFT_SHIFT,  // N
+    0x12,        MOD_LEFT_SHIFT,  // O
+    0x13,        MOD_LEFT_SHIFT,  // P
+    0x14,        MOD_LEFT_SHIFT,  // Q
+    0x15,        MOD_LEFT_SHIFT,  // R
+    0x16,        MOD_LEFT_SHIFT,  // S
+    0x17,        MOD_LEFT_SHIFT,  // T
+    0x18,        MOD_LEFT_SHIFT,  // U
+    0x19,        MOD_LEFT_SHIFT,  // V
+    0x1a,        MOD_LEFT_SHIFT,  // W
+    0x1b,        MOD_LEFT_SHIFT,  // X
+    0x1c,        MOD_LEFT_SHIFT,  // Y
+    0x1d,        MOD_LEFT_SHIFT,  // Z
+    0x2f,        MOD_NONE,        // [
+    0x31,        MOD_NONE,        // backslash
+    0x30,        MOD_NONE,        // ]
+    0x23,        MOD_LEFT_SHIFT,  // ^
+    0x2d,        MOD_LEFT_SHIFT,  // _
+    0x35,        MOD_NONE,        // `
+    0x04,        MOD_NONE,        // a
+    0x05,        MOD_NONE,        // b
+    0x06,        MOD_NONE,        // c
+    0x07,        MOD_NONE,        // d
+    0x08,        MOD_NONE,        // e
+    0x09,        MOD_NONE,        // f
+    0x0a,        MOD_NONE,        // g
+    0x0b,        MOD_NONE,        // h
+    0x0c,        MOD_NONE,        // i
+    0x0d,        MOD_NONE,        // j
+    0x0e,        MOD_NONE,        // k
+    0x0f,        MOD_NONE,        // l
+    0x10,        MOD_NONE,        // m
+    0x11,        MOD_NONE,        // n
+    0x12,        MOD_NONE,        // o
+    0x13,        MOD_NONE,        // p
+    0x14,        MOD_NONE,        // q
+    0x15,        MOD_NONE,        // r
+    0x16,        MOD_NONE,        // s
+    0x17,        MOD_NONE,        // t
+    0x18,        MOD_NONE,        // u
+    0x19,        MOD_NONE,        // v
+    0x1a,        MOD_NONE,        // w
+    0x1b,        MOD_NONE,        // x
+    0x1c,        MOD_NONE,        // y
+    0x1d,        MOD_NONE,        // z
+    0x2f,        MOD_LEFT_SHIFT,  // {
+    0x31,        MOD_LEFT_SHIFT,  // |
+    0x30,        MOD_LEFT_SHIFT,  // }
+    0x35,        MOD_LEFT_SHIFT,  // ~
+};
+
+static const uint8_t _layoutHU[] PROGMEM = {
+    0x2c,        MOD_NONE,        // space
+    0x21,        MOD_LEFT_SHIFT,  // !
+    0x1f,        MOD_LEFT_SHIFT,  // "
+    0x1b,        MOD_RIGHT_ALT,   // #
+    0x33,        MOD_RIGHT_ALT,   // $
+    0x22,        MOD_LEFT_SHIFT,  // %
+    0x06,        MOD_RIGHT_ALT,   // &
+    0x1e,        MOD_LEFT_SHIFT,  // quote
+    0x25,        MOD_LEFT_SHIFT,  // (
+    0x26,        MOD_LEFT_SHIFT,  // )
+    0x38,        MOD_RIGHT_ALT,   // *
+    0x20,        MOD_LEFT_SHIFT,  // +
+    0x36,        MOD_NONE,        // ,
+    0x38,        MOD_NONE,        // -
+    0x37,        MOD_NONE,        // .
+    0x23,        MOD_LEFT_SHIFT,  // /
+    0x35,        MOD_NONE,        // 0
+    0x1e,        MOD_NONE,        // 1
+    0x1f,        MOD_NONE,        // 2
+    0x20,        MOD_NONE,        // 3
+    0x21,        MOD_NONE,        // 4
+    0x22,        MOD_NONE,        // 5
+    0x23,        MOD_NONE,        // 6
+    0x24,        MOD_NONE,        // 7
+    0x25,        MOD_NONE,        // 8
+    0x26,        MOD_NONE,        // 9
+    0x37,        MOD_LEFT_SHIFT,  // :
+    0x36,        MOD_RIGHT_ALT,   // ;
+    0x64,        MOD_RIGHT_ALT,   // <
+    0x24,        MOD_LEFT_SHIFT,  // =
+    0x1d,        MOD_RIGHT_ALT,   // >
+    0x36,        MOD_LEFT_SHIFT,  // ?
+    0x19,        MOD_RIGHT_ALT,   // @
+    0x04,        MOD_LEFT_SHIFT,  // A
+    0x05,        MOD_LEFT_SHIFT,  // B
+    0x06,        MOD_LEFT_SHIFT,  // C
+    0x07,        MOD_LEFT_SHIFT,  // D
+    0x08,        MOD_LEFT_SHIFT,  // E
+    0x09,        MOD_LEFT_SHIFT,  // F
+    0x0a,        MOD_LEFT_SHIFT,  // G
+    0x0b,        MOD_LEFT_SHIFT,  // H
+    0x0c,        MOD_LEFT_SHIFT,  // I
+    0x0d,        MOD_LEFT_SHIFT,  // J
+    0x0e,        MOD_LEFT_SHIFT,  // K
+    0x0f,        MOD_LEFT_SHIFT,  // L
+    0x10,        MOD_LEFT_SHIFT,  // M
+    0x11,        MOD_LEFT_SHIFT,  // N
+    0x12,        MOD_LEFT_SHIFT,  // O
+    0x13,        MOD_LEFT_SHIFT,  // P
+    0x14,        MOD_LEFT_SHIFT,  // Q
+    0x15,        MOD_LEFT_SHIFT,  // R
+    0x16,        MOD_LEFT_SHIFT,  // S
+    0x17,        MOD_LEFT_SHIFT,  // T
+    0x18,        MOD_LEFT_SHIFT,  // U
+    0x19,        MOD_LEFT_SHIFT,  // V
+    0x1a,        MOD_LEFT_SHIFT,  // W
+    0x1b,        MOD_LEFT_SHIFT,  // X
+    0x1d,        MOD_LEFT_SHIFT,  // Y
+    0x1c,        MOD_LEFT_SHIFT,  // Z
+    0x09,        MOD_RIGHT_ALT,   // [
+    0x14,        MOD_RIGHT_ALT,   // backslash
+    0x0a,        MOD_RIGHT_ALT,   // ]
+    DEAD | 0x20, MOD_RIGHT_ALT,   // ^
+    0x38,        MOD_LEFT_SHIFT,  // _
+    DEAD | 0x24, MOD_RIGHT_ALT,   // `
+    0x04,        MOD_NONE,        // a
+    0x05,        MOD_NONE,        // b
+    0x06,        MOD_NONE,        // c
+    0x07,        MOD_NONE,        // d
+    0x08,        MOD_NONE,        // e
+    0x09,        MOD_NONE,        // f
+    0x0a,        MOD_NONE,        // g
+    0x0b,        MOD_NONE,        // h
+    0x0c,        MOD_NONE,        // i
+    0x0d,        MOD_NONE,        // j
+    0x0e,        MOD_NONE,        // k
+    0x0f,        MOD_NONE,        // l
+    0x10,        MOD_NONE,        // m
+    0x11,        MOD_NONE,        // n
+    0x12,        MOD_NONE,        // o
+    0x13,        MOD_NONE,        // p
+    0x14,        MOD_NONE,        // q
+    0x15,        MOD_NONE,        // r
+    0x16,        MOD_NONE,        // s
+    0x17,        MOD_NONE,        // t
+    0x18,        MOD_NONE,        // u
+    0x19,        MOD_NONE,        // v
+    0x1a,        MOD_NONE,        // w
+    0x1b,        MOD_NONE,        // x
+    0x1d,        MOD_NONE,        // y
+    0x1c,        MOD_NONE,        // z
+    0x05,        MOD_RIGHT_ALT,   // {
+    0x1a,        MOD_RIGHT_ALT,   // |
+    0x11,        MOD_RIGHT_ALT,   // }
+    DEAD | 0x1e, MOD_RIGHT_ALT,   // ~
+};
+
+static const uint8_t _layoutDE[] PROGMEM = {
+    0x2c,        MOD_NONE,        // space
+    0x1e,        MOD_LEFT_SHIFT,  // !
+    0x1f,        MOD_LEFT_SHIFT,  // "
+    0x32,        MOD_NONE,        // #
+    0x21,        MOD_LEFT_SHIFT,  // $
+    0x22,        MOD_LEFT_SHIFT,  // %
+    0x23,        MOD_LEFT_SHIFT,  // &
+    0x32,        MOD_LEFT_SHIFT,  // quote
+    0x25,        MOD_LEFT_SHIFT,  // (
+    0x26,        MOD_LEFT_SHIFT,  // )
+    0x30,        MOD_LEFT_SHIFT,  // *
+    0x30,        MOD_NONE,        // +
+    0x36,        MOD_NONE,        // ,
+    0x38,        MOD_NONE,        // -
+    0x37,        MOD_NONE,        // .
+    0x24,        MOD_LEFT_SHIFT,  // /
+    0x27,        MOD_NONE,        // 0
+    0x1e,        MOD_NONE,        // 1
+    0x1f,        MOD_NONE,        // 2
+    0x20,        MOD_NONE,        // 3
+    0x21,        MOD_NONE,        // 4
+    0x22,        MOD_NONE,        // 5
+    0x23,        MOD_NONE,        // 6
+    0x24,        MOD_NONE,        // 7
+    0x25,        MOD_NONE,        // 8
+    0x26,        MOD_NONE,        // 9
+    0x37,        MOD_LEFT_SHIFT,  // :
+    0x36,        MOD_LEFT_SHIFT,  // ;
+    0x64,        MOD_NONE,        // <
+    0x27,        MOD_LEFT_SHIFT,  // =
+    0x64,        MOD_LEFT_SHIFT,  // >
+    0x2d,        MOD_LEFT_SHIFT,  // ?
+    0x14,        MOD_RIGHT_ALT,   // @
+    0x04,        MOD_LEFT_SHIFT,  // A
+    0x05,        MOD_LEFT_SHIFT,  // B
+    0x06,        MOD_LEFT_SHIFT,  // C
+    0x07,        MOD_LEFT_SHIFT,  // D
+    0x08,        MOD_LEFT_SHIFT,  // E
+    0x09,        MOD_LEFT_SHIFT,  // F
+    0x0a,        MOD_LEFT_SHIFT,  // G
+    0x0b,        MOD_LEFT_SHIFT,  // H
+    0x0c,        MOD_LEFT_SHIFT,  // I
+    0x0d,        MOD_LEFT_SHIFT,  // J
+    0x0e,        MOD_LEFT_SHIFT,  // K
+    0x0f,        MOD_LEFT_SHIFT,  // L
+    0x10,        MOD_LEFT_SHIFT,  // M
+    0x11,        MOD_LEFT_SHIFT,  // N
+    0x12,        MOD_LEFT_SHIFT,  // O
+    0x13,        MOD_LEFT_SHIFT,  // P
+    0x14,        MOD_LEFT_SHIFT,  // Q
+    0x15,        MOD_LEFT_SHIFT,  // R
+    0x16,        MOD_LEFT_SHIFT,  // S
+    0x17,        MOD_LEFT_SHIFT,  // T
+    0x18,        MOD_LEFT_SHIFT,  // U
+    0x19,        MOD_LEFT_SHIFT,  // V
+    0x1a,        MOD_LEFT_SHIFT,  // W
+    0x1b,        MOD_LEFT_SHIFT,  // X
+    0x1d,        MOD_LEFT_SHIFT,  // Y
+    0x1c,        MOD_LEFT_SHIFT,  // Z
+    0x25,        MOD_RIGHT_ALT,   // [
+    0x2d,        MOD_RIGHT_ALT,   // backslash
+    0x26,        MOD_RIGHT_ALT,   // ]
+    DEAD | 0x35, MOD_NONE,        // ^
+    0x38,        MOD_LEFT_SHIFT,  // _
+    DEAD | 0x2e, MOD_LEFT_SHIFT,  // `
+    0x04,        MOD_NONE,        // a
+    0x05,        MOD_NONE,        // b
+    0x06,        MOD_NONE,        // c
+    0x07,        MOD_NONE,        // d
+    0x08,        MOD_NONE,        // e
+    0x09,        MOD_NONE,        // f
+    0x0a,        MOD_NONE,        // g
+    0x0b,        MOD_NONE,        // h
+    0x0c,        MOD_NONE,        // i
+    0x0d,        MOD_NONE,        // j
+    0x0e,        MOD_NONE,        // k
+    0x0f,        MOD_NONE,        // l
+    0x10,        MOD_NONE,        // m
+    0x11,        MOD_NONE,        // n
+    0x12,        MOD_NONE,        // o
+    0x13,        MOD_NONE,        // p
+    0x14,        MOD_NONE,        // q
+    0x15,        MOD_NONE,        // r
+    0x16,        MOD_NONE,        // s
+    0x17,        MOD_NONE,        // t
+    0x18,        MOD_NONE,        // u
+    0x19,        MOD_NONE,        // v
+    0x1a,        MOD_NONE,        // w
+    0x1b,        MOD_NONE,        // x
+    0x1d,        MOD_NONE,        // y
+    0x1c,        MOD_NONE,        // z
+    0x24,        MOD_RIGHT_ALT,   // {
+    0x64,        MOD_RIGHT_ALT,   // |
+    0x27,        MOD_RIGHT_ALT,   // }
+    0x30,        MOD_RIGHT_ALT,   // ~
+};
+
+#undef DEAD
+
+static const uint8_t* const _layouts[] = { _layoutUS, _layoutHU, _layoutDE };
+
+#endif
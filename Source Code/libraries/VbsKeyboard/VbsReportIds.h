@@ -0,0 +1,28 @@
+/*
+    VbsReportIds.h
+    
+    Copyright (c) 2021, Balazs Vecsey, www.vbstudio.hu
+    
+    Report IDs and vendor report types of VbsKeyboard, without anything else of the library, so
+    host software (the daemon in the Host folder) can include the same definitions as the firmware.
+    See "Reading the button directly from host software" in the README for the layouts.
+*/
+
+#ifndef VBS_REPORT_IDS_h
+#define VBS_REPORT_IDS_h
+
+// Report IDs (first byte of every report)
+#define HID_REPORTID_KEYBOARD       0x02
+#define HID_REPORTID_GAMEPAD        0x03
+#define HID_REPORTID_GENERICDESKTOP 0x04
+#define HID_REPORTID_VENDOR         0x05
+#define HID_REPORTID_FEATURE        0x06
+#define HID_REPORTID_CLOCK_SYNC     0x07
+
+// Vendor report types (first byte of the vendor report)
+#define VENDOR_PRESS_VELOCITY       0x01
+#define VENDOR_BUS_EVENT            0x02
+#define VENDOR_PRESS_TIME           0x03
+#define VENDOR_TAP_PATTERN          0x04
+
+#endif
@@ -0,0 +1,73 @@
+/*
+    TypeStringBenchmark.ino
+    
+    Compares typing speed of TypeString() against calling PressKey() for every character.
+    Open an empty text editor and plug in the board, typing starts after 5 seconds.
+    Both runs type the same text, then the results are typed in characters per second.
+*/
+
+#include <VbsKeyboard.h>
+
+#define TEXT "the quick brown fox jumps over the lazy dog "
+#define TEXT_REPEAT 4
+
+static void typeNumber(unsigned long value)
+{
+    char digits[10];
+    int count = 0;
+    do
+    {
+        digits[count++] = value % 10;
+        value /= 10;
+    } while (value > 0);
+    
+    while (count > 0)
+    {
+        const char digit = digits[--count];
+        Keyboard.PressKey(digit == 0 ? 0x27 : 0x1e + digit - 1);
+    }
+}
+
+// The naive path, one press and one release report per character
+static void typeNaive(const char* text)
+{
+    for (; *text; text++)
+    {
+        Keyboard.PressKey(*text == ' ' ? KEY_SPACE : KEY_A + (*text - 'a'));
+    }
+}
+
+void setup()
+{
+    delay(5000);
+    
+    // PressKey()
+    unsigned long start = millis();
+    for (int i = 0; i < TEXT_REPEAT; i++)
+    {
+        typeNaive(TEXT);
+    }
+    const unsigned long naiveTime = millis() - start;
+    Keyboard.PressKey(KEY_ENTER);
+    
+    // TypeString()
+    start = millis();
+    for (int i = 0; i < TEXT_REPEAT; i++)
+    {
+        Keyboard.TypeString(F(TEXT));
+        while (Keyboard.IsTyping());
+    }
+    const unsigned long typeTime = millis() - start;
+    Keyboard.PressKey(KEY_ENTER);
+    
+    // Results (characters per second)
+    const unsigned long chars = (sizeof(TEXT) - 1) * TEXT_REPEAT;
+    typeNumber(chars * 1000 / naiveTime);
+    Keyboard.PressKey(KEY_SPACE);
+    typeNumber(chars * 1000 / typeTime);
+    Keyboard.PressKey(KEY_ENTER);
+}
+
+void loop()
+{
+}